@@ -32,6 +32,7 @@
 
 /******************************************************************************/
 int16_t audioBuffer[AUDIO_BUFFER_LEN * 2];
+volatile AudioLoad audioLoad;
 
 static int waveform;
 
@@ -41,6 +42,8 @@ static int16_t cutoffMIDI;
 static int16_t cutoffTrack;
 
 static int16_t vibrato;
+static uint16_t vibratoRate;
+static uint8_t glideShift;
 static bool envsTrigger;
 static bool legato;
 
@@ -49,12 +52,43 @@ static int16_t  voicesMIDI[MAX_VOICES];
 static uint32_t voicesPitch[MAX_VOICES];
 static uint32_t voicesInc[MAX_VOICES];
 
+/*
+ * Para voices are kept from least to most recently used:
+ * free voices come first, then released voices in the
+ * order of their release, before stealing a playing one.
+ */
+#define VOICE_NONE		0xFF
+static uint8_t voicesOrder[MAX_VOICES];
+static uint8_t notesVoice[128];
+
 static Sawer oscs[MAX_OSCS];
 
+/******************************************************************************/
+/*
+ * Keys held in mono mode are linked by note number in
+ * arrival order and flagged in a bitmap for the low and
+ * high priorities: push, remove and pick are all O(1).
+ */
+#define HELD_NONE		0xFF
+static uint8_t heldPrev[128];
+static uint8_t heldNext[128];
+static uint16_t heldMap[8];
+static uint8_t heldLast;
+static int priority;
+
+static void heldClear();
+static void heldPush(uint8_t note);
+static bool heldRemove(uint8_t note);
+static uint8_t heldPick();
+
 /******************************************************************************/
 static void audioMuteOscs();
 static void audioMonoNoteOn(uint8_t note, int wave);
+static void audioMonoNoteOff(uint8_t note);
 static void audioParaNoteOn(uint8_t note, int wave);
+static int audioParaAlloc(uint8_t note);
+static void audioParaTouch(int voice);
+static void audioParaWave(int voice, int wave);
 static inline void audioRelease();
 
 static void audioComputePitch(int voice);
@@ -75,12 +109,22 @@ void audioInit()
 	cutoffTrack = 0;
 	
 	vibrato = 0;	
+	vibratoRate = VIBRATO_RATE;
+	glideShift = GLIDE_SHIFT;
 	envsTrigger = false;
 	legato = false;
 		
 	voicesCount = 0;
+	for (int i = 0; i < 128; i++)
+		notesVoice[i] = VOICE_NONE;
+	for (int i = 0; i < MAX_VOICES; i++)
+		voicesOrder[i] = i;
 	audioMuteOscs();
 	audioRelease();
+
+	priority = AUDIO_PRIORITY_LAST;
+	heldClear();
+	audioResetLoad();
 	
 	for (int i = 0; i < MAX_OSCS; i++) {
 		Sawer * o = &oscs[i];
@@ -100,11 +144,18 @@ void audioUpdate()
 	static int16_t phase = 0;
 	vibrato = ((phase ^ (phase >> 15)) << 1) ^ 0x8000;
 	__asm volatile ("mul.ss %0, %1, w0\n mov w1, %0\n" : "+r" (vibrato) : "r" (modWheel): "w0", "w1");
-	phase += 393; // ~6Hz 
+	phase += vibratoRate;
 		
 	static int robin = 0;
 	audioComputePitch(robin);
-	robin = (robin + 1) & (MAX_VOICES - 1);
+	if (++robin >= MAX_VOICES) robin = 0;
+
+// Loop turned on at the bottom (no edge to come)
+	static bool envLoop = false;
+	bool loop = uiSystem & SYSTEM_ENV_LOOP;
+	if (loop && !envLoop && !CM1CONbits.CPOL && CM1CONbits.COUT)
+		IFS1bits.CMIF = 1;
+	envLoop = loop;
 }
 
 /******************************************************************************/
@@ -137,6 +188,24 @@ void audioSetWheel(int16_t wheel)
 	modWheel = wheel << 1;
 }
 
+void audioSetGlide(int glide)
+{
+	glideShift = 1 + (glide >> 4);
+}
+
+void audioSetVibratoRate(int rate)
+{
+	vibratoRate = 64 + rate * 6;	// ~1Hz to ~12.6Hz
+}
+
+void audioSetPriority(int prio)
+{
+	if (prio > AUDIO_PRIORITY_HIGH) prio = AUDIO_PRIORITY_HIGH;
+	priority = prio;
+}
+
+int audioGetPriority() {return priority;}
+
 /******************************************************************************/
 inline void audioMuteOscs()
 {
@@ -149,17 +218,35 @@ inline void audioMuteOscs()
 /******************************************************************************/
 void audioNoteOn(uint8_t note)
 {
-	if (IS_WAVEFORM_MONO(waveform))
-		audioMonoNoteOn(note, waveform);
-	else audioParaNoteOn(note, waveform - MAX_WAVES);
+	audioNotesOn(&note, 1);
+}
+
+void audioNotesOn(const uint8_t * notes, int count)
+{
+	if (IS_WAVEFORM_MONO(waveform)) {
+		for (int i = 0; i < count; i++)
+			audioMonoNoteOn(notes[i], waveform);
+	}else{
+		int wave = waveform - MAX_WAVES;
+		for (int i = 0; i < count; i++)
+			audioParaNoteOn(notes[i], wave);
+	}
 	audioUpdateTracking();
 }
 
 void audioNoteOff(uint8_t note)
 {
-	for (int i = 0; i < MAX_VOICES; i++) {
-		if (voicesMIDI[i] != note) continue;
-		voicesMIDI[i] |= 0x8000;
+	if (IS_WAVEFORM_MONO(waveform)) {
+		audioMonoNoteOff(note);
+		return;
+	}
+
+	note &= 0x7F;
+	int voice = notesVoice[note];
+	if (voice != VOICE_NONE) {
+		notesVoice[note] = VOICE_NONE;
+		voicesMIDI[voice] |= 0x8000;
+		audioParaTouch(voice);
 		if (voicesCount) voicesCount--;
 	}
 	if (!voicesCount) audioRelease();
@@ -168,20 +255,27 @@ void audioNoteOff(uint8_t note)
 /******************************************************************************/
 void audioAllNotesOff()
 {
-	for (int i = 0; i < MAX_VOICES; i++)
+	for (int i = 0; i < MAX_VOICES; i++) {
+		int note = voicesMIDI[i];
+		if (note >= 0) notesVoice[note & 0x7F] = VOICE_NONE;
 		voicesMIDI[i] |= 0x8000;
+	}
 	voicesCount = 0;
+	heldClear();
 	audioRelease();
 }
 
 void audioAllSoundsOff()
 {
 	for (int i = 0; i < MAX_VOICES; i++) {
+		int note = voicesMIDI[i];
+		if (note >= 0) notesVoice[note & 0x7F] = VOICE_NONE;
 		voicesMIDI[i] = -1;
 		voicesInc[i] = 0;
 	}
 	legato = false;
 	voicesCount = 0;
+	heldClear();
 	audioRelease();
 }
 
@@ -195,6 +289,11 @@ void audioResetCtrls()
 /******************************************************************************/
 void audioMonoNoteOn(uint8_t note, int wave)
 {
+// Sound the note if it has priority
+	note &= 0x7F;
+	heldPush(note);
+	if (heldPick() != note) return;
+
 	oscs[0] = wavesMono[wave][0];
 	oscs[1] = wavesMono[wave][1];
 	oscs[2] = wavesMono[wave][2];
@@ -208,28 +307,159 @@ void audioMonoNoteOn(uint8_t note, int wave)
 	envsTrigger = true;
 }
 
+void audioMonoNoteOff(uint8_t note)
+{
+	note &= 0x7F;
+	if (!heldRemove(note)) return;
+	if (voicesMIDI[0] != note) return;
+
+// Return to a still held note
+	uint8_t held = heldPick();
+	if (held != HELD_NONE) {
+		legato = true;
+		voicesMIDI[0] = held;
+		audioComputePitch(0);
+		return;
+	}
+
+// Release the voice
+	voicesMIDI[0] |= 0x8000;
+	voicesCount = 0;
+	audioRelease();
+}
+
 void audioParaNoteOn(uint8_t note, int wave)
 {
 	bool trigger = !voicesCount;
 	if (trigger) audioMuteOscs();
 	
 	legato = false;
-	for (int i = 0; i < MAX_VOICES; i++) {
-		if (voicesMIDI[i] >= 0) continue;
-		oscs[i*2+0] = wavesPara[wave][0];
-		oscs[i*2+1] = wavesPara[wave][1];
-		voicesMIDI[i] = note;
-		audioComputePitch(i);
-		voicesCount++;
-		break;
+
+// Allocate a voice (or take it back)
+	note &= 0x7F;
+	int voice = notesVoice[note];
+	if (voice == VOICE_NONE) {
+		voice = audioParaAlloc(note);
+		if (voice == VOICE_NONE) return;
+		int old = voicesMIDI[voice];
+		if (old >= 0) notesVoice[old] = VOICE_NONE;
+		else voicesCount++;
+		notesVoice[note] = voice;
 	}
+	audioParaTouch(voice);
+
+	audioParaWave(voice, wave);
+	voicesMIDI[voice] = note;
+	audioComputePitch(voice);
 
 	bool always = uiSystem & SYSTEM_ENV_RETRIG;
 	if (trigger || always) envsTrigger = true;
 }
 
+int audioParaAlloc(uint8_t note)
+{
+// Free voices first, then released ones
+	for (int i = 0; i < MAX_VOICES; i++) {
+		int voice = voicesOrder[i];
+		if (voicesMIDI[voice] == -1) return voice;
+	}
+	for (int i = 0; i < MAX_VOICES; i++) {
+		int voice = voicesOrder[i];
+		if (voicesMIDI[voice] < 0) return voice;
+	}
+
+// Steal the oldest voice
+	if (priority == AUDIO_PRIORITY_LAST)
+		return voicesOrder[0];
+
+// Or the voice with the least priority
+	int voice = VOICE_NONE;
+	int worst = note;
+	for (int i = 0; i < MAX_VOICES; i++) {
+		int held = voicesMIDI[voicesOrder[i]];
+		if (priority == AUDIO_PRIORITY_LOW ? held <= worst : held >= worst) continue;
+		voice = voicesOrder[i];
+		worst = held;
+	}
+	return voice;
+}
+
+void audioParaTouch(int voice)
+{
+// Move the voice at the end of the order
+	int i = 0;
+	while (voicesOrder[i] != voice) i++;
+	for (; i < MAX_VOICES - 1; i++)
+		voicesOrder[i] = voicesOrder[i + 1];
+	voicesOrder[MAX_VOICES - 1] = voice;
+}
+
+void audioParaWave(int voice, int wave)
+{
+// Quad voices use the mono oscillators
+#if VOICE_OSCS == 4
+	const Sawer * src = wavesMono[wave];
+#else
+	const Sawer * src = wavesPara[wave];
+#endif
+	Sawer * dst = &oscs[voice * VOICE_OSCS];
+	for (int i = 0; i < VOICE_OSCS; i++)
+		dst[i] = src[i];
+}
+
 int audioGetNoVoices() {return voicesCount;}
 
+/******************************************************************************/
+void heldClear()
+{
+	for (int i = 0; i < 8; i++)
+		heldMap[i] = 0;
+	heldLast = HELD_NONE;
+}
+
+void heldPush(uint8_t note)
+{
+	heldRemove(note);
+	heldPrev[note] = heldLast;
+	heldNext[note] = HELD_NONE;
+	if (heldLast != HELD_NONE)
+		heldNext[heldLast] = note;
+	heldLast = note;
+	heldMap[note >> 4] |= 1 << (note & 0xF);
+}
+
+bool heldRemove(uint8_t note)
+{
+	uint16_t bit = 1 << (note & 0xF);
+	if (!(heldMap[note >> 4] & bit)) return false;
+	heldMap[note >> 4] &= ~bit;
+
+	uint8_t prev = heldPrev[note];
+	uint8_t next = heldNext[note];
+	if (prev != HELD_NONE) heldNext[prev] = next;
+	if (next != HELD_NONE) heldPrev[next] = prev;
+	else heldLast = prev;
+	return true;
+}
+
+uint8_t heldPick()
+{
+	if (priority == AUDIO_PRIORITY_LOW) {
+		for (int i = 0; i < 8; i++) {
+			uint16_t map = heldMap[i];
+			if (map) return (i << 4) + __builtin_ff1r(map) - 1;
+		}
+		return HELD_NONE;
+	}else if (priority == AUDIO_PRIORITY_HIGH) {
+		for (int i = 7; i >= 0; i--) {
+			uint16_t map = heldMap[i];
+			if (map) return (i << 4) + 16 - __builtin_ff1l(map);
+		}
+		return HELD_NONE;
+	}
+	return heldLast;
+}
+
 /******************************************************************************/
 static inline void audioRelease()
 {
@@ -239,19 +469,19 @@ static inline void audioRelease()
 
 /******************************************************************************/
 static const uint32_t pt[] = {
-	(uint32_t) (0x1p24f * 4186.009044809578f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 4434.922095629953f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 4698.636286678520f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 4978.031739553295f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 5274.040910605920f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 5587.651702928062f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 5919.910763386150f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 6271.926975707989f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 6644.875161279122f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 7040.000000000000f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 7458.620184289437f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 7902.132820097988f / FRQ_SAMPLE),
-	(uint32_t) (0x1p24f * 8372.018089619156f / FRQ_SAMPLE),
+	(uint32_t) (0x1p24f * 4186.009044809578f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 4434.922095629953f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 4698.636286678520f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 4978.031739553295f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 5274.040910605920f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 5587.651702928062f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 5919.910763386150f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 6271.926975707989f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 6644.875161279122f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 7040.000000000000f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 7458.620184289437f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 7902.132820097988f / FRQ_RENDER),
+	(uint32_t) (0x1p24f * 8372.018089619156f / FRQ_RENDER),
 };
 
 void audioUpdateTracking()
@@ -260,7 +490,7 @@ void audioUpdateTracking()
 
 	for (int i = 0; i < MAX_VOICES; i++) {
 		int note = voicesMIDI[i];
-		if (note == -1) return;
+		if (note == -1) continue;	// Voices are not packed
 		note &= 0xFF;				// Remove release flag
 		if (note > 91) note = 91;	// G6 = ~1568Hz
 		if (note < 28) note = 28;	// E1 = ~41Hz
@@ -270,6 +500,7 @@ void audioUpdateTracking()
 		newTrack = track;
 	}
 
+	if (newTrack == -32768) return;	// No voice played yet
 	cutoffTrack = newTrack;
 }
 
@@ -283,10 +514,8 @@ void audioUpdateWaveforms()
 		oscs[3] = wavesMono[wave][3];
 	}else{
 		int wave = waveform - MAX_WAVES;
-		for (int i = 0; i < MAX_VOICES; i++) {
-			oscs[i*2+0] = wavesPara[wave][0];
-			oscs[i*2+1] = wavesPara[wave][1];
-		}
+		for (int i = 0; i < MAX_VOICES; i++)
+			audioParaWave(i, wave);
 	}
 }
 
@@ -300,16 +529,17 @@ void audioComputePitch(int voice)
 	int16_t pitch = note << 8;
 	if (pitch > 0x6000) {
 		voicesInc[voice] = 0;
-		voicesPitch[voice] = 0x6000l << GLIDE_SHIFT;
+		voicesPitch[voice] = 0x6000l << GLIDE_SHIFT_MAX;
 		return;
 	}
 	pitch += vibrato + pitchBend;
 	if (pitch < 0) pitch = 0;
 
 // Compute glide effect
-	voicesPitch[voice] += pitch - (voicesPitch[voice] >> GLIDE_SHIFT);
+	int32_t glide = ((int32_t) pitch << GLIDE_SHIFT_MAX) - (int32_t) voicesPitch[voice];
+	voicesPitch[voice] += glide >> glideShift;
 	if (legato || uiSystem & SYSTEM_PITCH_GLIDE)
-		pitch = voicesPitch[voice] >> GLIDE_SHIFT;
+		pitch = voicesPitch[voice] >> GLIDE_SHIFT_MAX;
 
 // Compute the final pitch
 	int16_t coarse = pitch >> 8;
@@ -322,6 +552,72 @@ void audioComputePitch(int voice)
 	voicesInc[voice] = inc >> (9 - octave);
 }
 
+/******************************************************************************/
+void audioEnvEvent()
+{
+// Serviced on the comparator interrupt
+	if (!CM1CONbits.COUT) return;
+	if (!CM1CONbits.CPOL) {				// Filter env. reached bottom
+		if (uiSystem & SYSTEM_ENV_LOOP) {
+			CVRCONbits.CVR = 24;		// Vref = 2.475V
+			CM1CONbits.CPOL = 1;		// Normal polarity
+			VCF_ENV_SetHigh();			// Trigger the env.
+		}
+	}else{								// Filter env. reached top
+		CVRCONbits.CVR = 1;				// Vref = 0.103V
+		CM1CONbits.CPOL = 0;			// Inverted polarity
+		VCF_ENV_SetLow();				// Release the env.
+	}
+}
+
+/******************************************************************************/
+uint16_t audioPosition()
+{
+// Words sent since the start of the block
+	uint16_t pos = AUDIO_BUFFER_LEN * 2 - DMACNT0;
+	if (pos >= AUDIO_BUFFER_LEN) pos -= AUDIO_BUFFER_LEN;
+	return pos;
+}
+
+bool audioLate(const int16_t * buffer)
+{
+// DMA already reading the half to render
+	uint16_t pos = AUDIO_BUFFER_LEN * 2 - DMACNT0;
+	bool second = pos >= AUDIO_BUFFER_LEN;
+	if (buffer == audioBuffer) return !second;
+	return second;
+}
+
+void audioMeasure(uint16_t entry)
+{
+	uint16_t exit = audioPosition();
+	if (exit < entry) {
+		exit += AUDIO_BUFFER_LEN;
+		audioLoad.overruns++;
+	}
+
+	audioLoad.entry = entry;
+	audioLoad.exit = exit;
+	if (entry > audioLoad.entryMax) audioLoad.entryMax = entry;
+	if (exit > audioLoad.exitMax) audioLoad.exitMax = exit;
+	if (exit < audioLoad.exitMin) audioLoad.exitMin = exit;
+
+// Moving average (1/16)
+	int16_t mean = audioLoad.exitMean;
+	mean += ((int16_t) (exit << 4) - mean) >> 4;
+	audioLoad.exitMean = mean;
+}
+
+void audioResetLoad()
+{
+	__asm volatile("disi #12\n");
+	audioLoad.entryMax = 0;
+	audioLoad.exitMin = 0xFFFF;
+	audioLoad.exitMax = 0;
+	audioLoad.overruns = 0;
+	audioLoad.late = 0;
+}
+
 /******************************************************************************/
 void audioRender(int16_t * buffer)
 {
@@ -341,125 +637,202 @@ void audioRender(int16_t * buffer)
 		VCF_ENV_SetHigh();				// Trigger VCF env.
 		VCA_ENV_SetHigh();				// Trigger VCA env.
 		envsTrigger = false;
+		if (CM1CONbits.COUT)			// Already at the top
+			IFS1bits.CMIF = 1;
 	}
 
-	if (CM1CONbits.COUT) {
-		if (!CM1CONbits.CPOL) {			// Filter env. reached bottom
-			if (uiSystem & SYSTEM_ENV_LOOP) {
-				CVRCONbits.CVR = 24;	// Vref = 2.475V
-				CM1CONbits.CPOL = 1;	// Normal polarity
-				VCF_ENV_SetHigh();		// Trigger the env.
-			}
-		}else{							// Filter env. reached top
-			CVRCONbits.CVR = 1;			// Vref = 0.103V
-			CM1CONbits.CPOL = 0;		// Inverted polarity
-			VCF_ENV_SetLow();			// Release the env.
-		}
-	}
-
-// Read switches state (in sync)
-	TRISA |= PORTA_TACTS;
-	TRISB |= PORTB_TACTS;
-	__asm volatile ("repeat #10\n nop\n");
-	uiSwitchPortA = PORTA;
-	uiSwitchPortB = PORTB;
-	TRISA &= ~PORTA_TACTS;
-	TRISB &= ~PORTB_TACTS;
-
 	//LED_WAVE_SetLow();
 }
 
 /******************************************************************************/
-inline void audioRenderMono(int16_t * buffer, uint16_t cutoff)
-{
-	__asm volatile (" \
-	; Process OSC1 and OSC2 (mono mode) \n \
-		1:\n \
-		mov _voicesInc, w0,\n \
-		mov _voicesInc+2, w1\n \
-		2: ;Compute OSCs increments\n \
-		mov _oscs+4, w2\n \
+/*
+ * Render kernels are built from templates processing four
+ * or two oscillators over the block. Each oscillator takes
+ * the increment of its own voice, so any number of
+ * oscillators per voice is rendered by the same code.
+ */
+#define STR(x)				#x
+#define XSTR(x)				STR(x)
+
+#define RENDER_PAIR(oa, ob, va, vb, store) " \
+		1: ;Compute OSCs increments\n \
+		mov _voicesInc+4*(" XSTR(va) "), w0\n \
+		mov _voicesInc+4*(" XSTR(va) ")+2, w1\n \
+		mov _oscs+8*(" XSTR(oa) ")+4, w2\n \
 		mul.us w0, w2, w4\n \
 		mul.us w1, w2, w6\n \
 		add w5, w6, w5\n \
-		mov _oscs+12, w2\n \
+		mov _voicesInc+4*(" XSTR(vb) "), w0\n \
+		mov _voicesInc+4*(" XSTR(vb) ")+2, w1\n \
+		mov _oscs+8*(" XSTR(ob) ")+4, w2\n \
 		mul.us w0, w2, w6\n \
 		mul.us w1, w2, w8\n \
 		add w7, w8, w7\n \
-		3: ;Load OSCs counters\n \
-		mov _oscs+0, w8\n \
-		mov _oscs+2, w9\n \
-		mov _oscs+8, w10\n \
-		mov _oscs+10, w11\n \
+		2: ;Load OSCs counters\n \
+		mov _oscs+8*(" XSTR(oa) "), w8\n \
+		mov _oscs+8*(" XSTR(oa) ")+2, w9\n \
+		mov _oscs+8*(" XSTR(ob) "), w10\n \
+		mov _oscs+8*(" XSTR(ob) ")+2, w11\n \
 		mov %0, w2\n \
-		add #256, w2\n \
-		4: ;Update OSCs counters\n \
+		add #(" XSTR(AUDIO_BUFFER_LEN * 2) "), w2\n \
+		3: ;Update OSCs counters\n \
 		add w8, w4, w8\n \
 		addc w9, w5, w9\n \
 		add w10, w6, w10\n \
 		addc w11, w7, w11\n \
-		5: ;Compute OSCs waveforms\n \
-		mov _oscs+6, w0\n \
-		mov _oscs+14, w1\n \
+		4: ;Compute OSCs waveforms\n \
+		mov _oscs+8*(" XSTR(oa) ")+6, w0\n \
+		mov _oscs+8*(" XSTR(ob) ")+6, w1\n \
 		asr w9, w0, w0\n \
 		asr w11, w1, w1\n \
-		inc2 %0, %0\n \
-		add w0, w1, w0\n \
-		asr w0, #1, w1\n \
-		sub w0, w1, [%0++]\n \
-		6: ; Loop over\n \
+		" store " \
+		5: ; Loop over\n \
 		cp %0, w2\n \
-		bra nz, 4b\n \
+		bra nz, 3b\n \
 		6: ; Write back counters\n \
-		sub #256, %0\n \
-		mov w8, _oscs+0\n \
-		mov w9, _oscs+2\n \
-		mov w10, _oscs+8\n \
-		mov w11, _oscs+10\n \
-	; Process OSC3 and OSC4 (mono mode) \n \
-		1:\n \
-		mov _voicesInc, w0,\n \
-		mov _voicesInc+2, w1\n \
-		2: ;Compute OSCs increments\n \
-		mov _oscs+20, w2\n \
+		sub #(" XSTR(AUDIO_BUFFER_LEN * 2) "), %0\n \
+		mov w8, _oscs+8*(" XSTR(oa) ")\n \
+		mov w9, _oscs+8*(" XSTR(oa) ")+2\n \
+		mov w10, _oscs+8*(" XSTR(ob) ")\n \
+		mov w11, _oscs+8*(" XSTR(ob) ")+2\n "
+
+/*
+ * Four oscillators are rendered in a single pass: their
+ * counters stay in registers, the increments are read from
+ * memory and the four waveforms are mixed before a single
+ * store per frame, halving the passes over the buffer.
+ */
+static uint32_t renderIncs[4] __attribute__ ((used));
+
+#define RENDER_INC(o, v, n) " \
+		mov _voicesInc+4*(" XSTR(v) "), w0\n \
+		mov _voicesInc+4*(" XSTR(v) ")+2, w1\n \
+		mov _oscs+8*(" XSTR(o) ")+4, w2\n \
 		mul.us w0, w2, w4\n \
 		mul.us w1, w2, w6\n \
 		add w5, w6, w5\n \
-		mov _oscs+28, w2\n \
-		mul.us w0, w2, w6\n \
-		mul.us w1, w2, w8\n \
-		add w7, w8, w7\n \
-		3: ;Load OSCs counters\n \
-		mov _oscs+16, w8\n \
-		mov _oscs+18, w9\n \
-		mov _oscs+24, w10\n \
-		mov _oscs+26, w11\n \
+		mov w4, _renderIncs+4*" XSTR(n) "\n \
+		mov w5, _renderIncs+4*" XSTR(n) "+2\n "
+
+#define RENDER_QUAD(oa, ob, oc, od, va, vb, vc, vd, store) " \
+		1: ;Compute OSCs increments\n " \
+		RENDER_INC(oa, va, 0) \
+		RENDER_INC(ob, vb, 1) \
+		RENDER_INC(oc, vc, 2) \
+		RENDER_INC(od, vd, 3) " \
+		2: ;Load OSCs counters\n \
+		mov _oscs+8*(" XSTR(oa) "), w4\n \
+		mov _oscs+8*(" XSTR(oa) ")+2, w5\n \
+		mov _oscs+8*(" XSTR(ob) "), w6\n \
+		mov _oscs+8*(" XSTR(ob) ")+2, w7\n \
+		mov _oscs+8*(" XSTR(oc) "), w8\n \
+		mov _oscs+8*(" XSTR(oc) ")+2, w9\n \
+		mov _oscs+8*(" XSTR(od) "), w10\n \
+		mov _oscs+8*(" XSTR(od) ")+2, w11\n \
+		mov #_renderIncs, w3\n \
 		mov %0, w2\n \
-		add #256, w2\n \
-		4: ;Update OSCs counters\n \
-		add w8, w4, w8\n \
-		addc w9, w5, w9\n \
-		add w10, w6, w10\n \
-		addc w11, w7, w11\n \
-		5: ;Compute OSCs waveforms\n \
-		mov _oscs+22, w0\n \
-		mov _oscs+30, w1\n \
+		add #(" XSTR(AUDIO_BUFFER_LEN * 2) "), w2\n \
+		3: ;Update OSCs counters\n \
+		add w4, [w3++], w4\n \
+		addc w5, [w3++], w5\n \
+		add w6, [w3++], w6\n \
+		addc w7, [w3++], w7\n \
+		add w8, [w3++], w8\n \
+		addc w9, [w3++], w9\n \
+		add w10, [w3++], w10\n \
+		addc w11, [w3++], w11\n \
+		sub #16, w3\n \
+		4: ;Compute and mix OSCs waveforms\n \
+		mov _oscs+8*(" XSTR(oa) ")+6, w0\n \
+		asr w5, w0, w1\n \
+		mov _oscs+8*(" XSTR(ob) ")+6, w0\n \
+		asr w7, w0, w0\n \
+		add w0, w1, w1\n \
+		mov _oscs+8*(" XSTR(oc) ")+6, w0\n \
 		asr w9, w0, w0\n \
-		asr w11, w1, w1\n \
-		mov %1, [%0++]\n \
-		add w0, w1, w0\n \
-		asr w0, #1, w1\n \
-		sub w0, w1, w0\n \
-		add w0, [%0], [%0++]\n \
-		6: ; Loop over\n \
+		add w0, w1, w1\n \
+		mov _oscs+8*(" XSTR(od) ")+6, w0\n \
+		asr w11, w0, w0\n \
+		" store " \
+		5: ; Loop over\n \
 		cp %0, w2\n \
-		bra nz, 4b\n \
+		bra nz, 3b\n \
 		6: ; Write back counters\n \
-		mov w8, _oscs+16\n \
-		mov w9, _oscs+18\n \
-		mov w10, _oscs+24\n \
-		mov w11, _oscs+26\n \
-	"
+		sub #(" XSTR(AUDIO_BUFFER_LEN * 2) "), %0\n \
+		mov w4, _oscs+8*(" XSTR(oa) ")\n \
+		mov w5, _oscs+8*(" XSTR(oa) ")+2\n \
+		mov w6, _oscs+8*(" XSTR(ob) ")\n \
+		mov w7, _oscs+8*(" XSTR(ob) ")+2\n \
+		mov w8, _oscs+8*(" XSTR(oc) ")\n \
+		mov w9, _oscs+8*(" XSTR(oc) ")+2\n \
+		mov w10, _oscs+8*(" XSTR(od) ")\n \
+		mov w11, _oscs+8*(" XSTR(od) ")+2\n "
+
+/*
+ * Sample store: first pass writes the cutoff, next ones mix.
+ * At reduced rates, each sample is held over RENDER_DIV frames.
+ */
+#if RENDER_DIV == 1
+	#define RENDER_HOLD(s)		s
+	#define RENDER_PARA_FIRST	"mov %1, [%0++]\n add w0, w1, [%0++]\n"
+	#define RENDER_MONO_FIRST	"mov %1, [%0++]\n add w0, w1, w0\n asr w0, #1, w1\n sub w0, w1, [%0++]\n"
+#else
+	#if RENDER_DIV == 2
+		#define RENDER_HOLD(s)	s s
+	#elif RENDER_DIV == 4
+		#define RENDER_HOLD(s)	s s s s
+	#else
+		#error "Oscillators rate divider must be 1, 2 or 4"
+	#endif
+	#define RENDER_PARA_FIRST	"add w0, w1, w0\n" RENDER_HOLD("mov %1, [%0++]\n mov w0, [%0++]\n")
+	#define RENDER_MONO_FIRST	"add w0, w1, w0\n asr w0, #1, w1\n sub w0, w1, w0\n" RENDER_HOLD("mov %1, [%0++]\n mov w0, [%0++]\n")
+#endif
+#define RENDER_PARA_NEXT	"add w0, w1, w0\n" RENDER_HOLD("inc2 %0, %0\n add w0, [%0], [%0++]\n")
+#define RENDER_MONO_NEXT	"add w0, w1, w0\n asr w0, #1, w1\n sub w0, w1, w0\n" RENDER_HOLD("inc2 %0, %0\n add w0, [%0], [%0++]\n")
+
+/* Quad q or pair p of the para oscillators */
+#define RENDER_PARA_QUAD(q, store) \
+	RENDER_QUAD(4*q, 4*q+1, 4*q+2, 4*q+3, \
+		(4*q)/VOICE_OSCS, (4*q+1)/VOICE_OSCS, (4*q+2)/VOICE_OSCS, (4*q+3)/VOICE_OSCS, store)
+#define RENDER_PARA_PAIR(p, store) \
+	RENDER_PAIR(2*p, 2*p+1, (2*p)/VOICE_OSCS, (2*p+1)/VOICE_OSCS, store)
+
+/*
+ * Cycle model of a block (see the report in audio.h):
+ * a quad takes 52 cycles of setup, 23 cycles per sample
+ * plus the store (2 or 3 cycles in para mode, 1 + 2
+ * cycles per frame held at reduced rates), a pair 23
+ * cycles of setup and 11 cycles per sample plus the store.
+ */
+#define RENDER_FRAMES		(AUDIO_BUFFER_LEN / 2)
+#define RENDER_BUDGET		(FRQ_FCY / FRQ_SAMPLE * RENDER_FRAMES)
+#define RENDER_OVERHEAD		120		// Interrupt and envelopes
+#define RENDER_QUADS		(MAX_OSCS / 4)
+#define RENDER_PAIRS		((MAX_OSCS & 3) / 2)
+#if RENDER_DIV == 1
+	#define RENDER_CYCLES	(RENDER_QUADS * (52 + RENDER_FRAMES * 26) - RENDER_FRAMES + \
+							 RENDER_PAIRS * (23 + RENDER_FRAMES * 14))
+#else
+	#define RENDER_CYCLES	(RENDER_QUADS * (52 + RENDER_FRAMES / RENDER_DIV * (24 + 2 * RENDER_DIV)) + \
+							 RENDER_PAIRS * (23 + RENDER_FRAMES / RENDER_DIV * (12 + 2 * RENDER_DIV)))
+#endif
+
+#if MAX_OSCS & 1 || MAX_OSCS < 4 || MAX_OSCS > 16
+	#error "Oscillators are rendered by pairs (4 to 16)"
+#endif
+#if RENDER_FRAMES % RENDER_DIV || AUDIO_BUFFER_LEN > 510
+	#error "Audio blocks must hold whole samples (up to 255 frames)"
+#endif
+#if RENDER_CYCLES + RENDER_OVERHEAD > RENDER_BUDGET
+	#error "Para render exceeds the block budget"
+#endif
+
+/******************************************************************************/
+inline void audioRenderMono(int16_t * buffer, uint16_t cutoff)
+{
+	__asm volatile (
+		"; Process OSC1 to OSC4 (mono mode) \n"
+		RENDER_QUAD(0, 1, 2, 3, 0, 0, 0, 0, RENDER_MONO_FIRST)
 	: "+r" (buffer)
 	: "r" (cutoff)
 	: "w0", "w1", "w2", "w3", "w4", "w5", "w6", "w7", "w8", "w9", "w10", "w11", "memory");
@@ -467,174 +840,25 @@ inline void audioRenderMono(int16_t * buffer, uint16_t cutoff)
 
 inline void audioRenderPara(int16_t * buffer, uint16_t cutoff)
 {
-	__asm volatile (" \
-	; Process Voice 1 (OSC1 & OSC2) \n \
-		1:\n \
-		mov _voicesInc, w0,\n \
-		mov _voicesInc+2, w1\n \
-		2: ;Compute OSCs increments\n \
-		mov _oscs+4, w2\n \
-		mul.us w0, w2, w4\n \
-		mul.us w1, w2, w6\n \
-		add w5, w6, w5\n \
-		mov _oscs+12, w2\n \
-		mul.us w0, w2, w6\n \
-		mul.us w1, w2, w8\n \
-		add w7, w8, w7\n \
-		3: ;Load OSCs counters\n \
-		mov _oscs+0, w8\n \
-		mov _oscs+2, w9\n \
-		mov _oscs+8, w10\n \
-		mov _oscs+10, w11\n \
-		mov %0, w2\n \
-		add #256, w2\n \
-		4: ;Update OSCs counters\n \
-		add w8, w4, w8\n \
-		addc w9, w5, w9\n \
-		add w10, w6, w10\n \
-		addc w11, w7, w11\n \
-		5: ;Compute OSCs waveforms\n \
-		mov _oscs+6, w0\n \
-		mov _oscs+14, w1\n \
-		asr w9, w0, w0\n \
-		asr w11, w1, w1\n \
-		inc2 %0, %0\n \
-		add w0, w1, [%0++]\n \
-		6: ; Loop over\n \
-		cp %0, w2\n \
-		bra nz, 4b\n \
-		6: ; Write back counters\n \n \
-		sub #256, %0\n \
-		mov w8, _oscs+0\n \
-		mov w9, _oscs+2\n \
-		mov w10, _oscs+8\n \
-		mov w11, _oscs+10\n \
-	; Process Voice 2 (OSC3 & OSC4) \n \
-		1:\n \
-		mov _voicesInc+4, w0,\n \
-		mov _voicesInc+6, w1\n \
-		2: ;Compute OSCs increments\n \
-		mov _oscs+20, w2\n \
-		mul.us w0, w2, w4\n \
-		mul.us w1, w2, w6\n \
-		add w5, w6, w5\n \
-		mov _oscs+28, w2\n \
-		mul.us w0, w2, w6\n \
-		mul.us w1, w2, w8\n \
-		add w7, w8, w7\n \
-		3: ;Load OSCs counters\n \
-		mov _oscs+16, w8\n \
-		mov _oscs+18, w9\n \
-		mov _oscs+24, w10\n \
-		mov _oscs+26, w11\n \
-		mov %0, w2\n \
-		add #256, w2\n \
-		4: ;Update OSCs counters\n \
-		add w8, w4, w8\n \
-		addc w9, w5, w9\n \
-		add w10, w6, w10\n \
-		addc w11, w7, w11\n \
-		5: ;Compute OSCs waveforms\n \
-		mov _oscs+22, w0\n \
-		mov _oscs+30, w1\n \
-		asr w9, w0, w0\n \
-		asr w11, w1, w1\n \
-		inc2 %0, %0\n \
-		add w0, w1, w0\n \
-		add w0, [%0], [%0++]\n \
-		6: ; Loop over\n \
-		cp %0, w2\n \
-		bra nz, 4b\n \
-		6: ; Write back counters\n \
-		sub #256, %0\n \
-		mov w8, _oscs+16\n \
-		mov w9, _oscs+18\n \
-		mov w10, _oscs+24\n \
-		mov w11, _oscs+26\n \
-	; Process Voice 3 (OSC5 & OSC6) \n \
-		1:\n \
-		mov _voicesInc+8, w0,\n \
-		mov _voicesInc+10, w1\n \
-		2: ;Compute OSCs increments\n \
-		mov _oscs+36, w2\n \
-		mul.us w0, w2, w4\n \
-		mul.us w1, w2, w6\n \
-		add w5, w6, w5\n \
-		mov _oscs+44, w2\n \
-		mul.us w0, w2, w6\n \
-		mul.us w1, w2, w8\n \
-		add w7, w8, w7\n \
-		3: ;Load OSCs counters\n \
-		mov _oscs+32, w8\n \
-		mov _oscs+34, w9\n \
-		mov _oscs+40, w10\n \
-		mov _oscs+42, w11\n \
-		mov %0, w2\n \
-		add #256, w2\n \
-		4: ;Update OSCs counters\n \
-		add w8, w4, w8\n \
-		addc w9, w5, w9\n \
-		add w10, w6, w10\n \
-		addc w11, w7, w11\n \
-		5: ;Compute OSCs waveforms\n \
-		mov _oscs+38, w0\n \
-		mov _oscs+46, w1\n \
-		asr w9, w0, w0\n \
-		asr w11, w1, w1\n \
-		inc2 %0, %0\n \
-		add w0, w1, w0\n \
-		add w0, [%0], [%0++]\n \
-		6: ; Loop over\n \
-		cp %0, w2\n \
-		bra nz, 4b\n \
-		6: ; Write back counters\n \
-		sub #256, %0\n \
-		mov w8, _oscs+32\n \
-		mov w9, _oscs+34\n \
-		mov w10, _oscs+40\n \
-		mov w11, _oscs+42\n \
-	; Process Voice 4 (OSC7 & OSC8) \n \
-		1:\n \
-		mov _voicesInc+12, w0,\n \
-		mov _voicesInc+14, w1\n \
-		2: ;Compute OSCs increments\n \
-		mov _oscs+52, w2\n \
-		mul.us w0, w2, w4\n \
-		mul.us w1, w2, w6\n \
-		add w5, w6, w5\n \
-		mov _oscs+60, w2\n \
-		mul.us w0, w2, w6\n \
-		mul.us w1, w2, w8\n \
-		add w7, w8, w7\n \
-		3: ;Load OSCs counters\n \
-		mov _oscs+48, w8\n \
-		mov _oscs+50, w9\n \
-		mov _oscs+56, w10\n \
-		mov _oscs+58, w11\n \
-		mov %0, w2\n \
-		add #256, w2\n \
-		4: ;Update OSCs counters\n \
-		add w8, w4, w8\n \
-		addc w9, w5, w9\n \
-		add w10, w6, w10\n \
-		addc w11, w7, w11\n \
-		5: ;Compute OSCs waveforms\n \
-		mov _oscs+54, w0\n \
-		mov _oscs+62, w1\n \
-		asr w9, w0, w0\n \
-		asr w11, w1, w1\n \
-		mov %1, [%0++]\n \
-		add w0, w1, w0\n \
-		add w0, [%0], [%0++]\n \
-		6: ; Loop over\n \
-		cp %0, w2\n \
-		bra nz, 4b\n \
-		6: ; Write back counters\n \n \
-		mov w8, _oscs+48\n \
-		mov w9, _oscs+50\n \
-		mov w10, _oscs+56\n \
-		mov w11, _oscs+58\n \
-	"
+	__asm volatile (
+		"; Process OSC1 to OSC4 \n"
+		RENDER_PARA_QUAD(0, RENDER_PARA_FIRST)
+#if MAX_OSCS >= 8
+		"; Process OSC5 to OSC8 \n"
+		RENDER_PARA_QUAD(1, RENDER_PARA_NEXT)
+#endif
+#if MAX_OSCS >= 12
+		"; Process OSC9 to OSC12 \n"
+		RENDER_PARA_QUAD(2, RENDER_PARA_NEXT)
+#endif
+#if MAX_OSCS >= 16
+		"; Process OSC13 to OSC16 \n"
+		RENDER_PARA_QUAD(3, RENDER_PARA_NEXT)
+#endif
+#if RENDER_PAIRS
+		"; Process the last OSCs pair \n"
+		RENDER_PARA_PAIR(2 * RENDER_QUADS, RENDER_PARA_NEXT)
+#endif
 	: "+r" (buffer)
 	: "r" (cutoff)
 	: "w0", "w1", "w2", "w3", "w4", "w5", "w6", "w7", "w8", "w9", "w10", "w11", "memory");
@@ -681,48 +905,17 @@ void audioRenderMono(int16_t * buffer)
 
 void audioRenderPara(int16_t * buffer)
 {
-	uint32_t inc;
-	uint32_t register incs[8];
-	inc = voicesInc[0];
-	incs[0] = inc * (int32_t) oscs[0].rate;
-	incs[1] = inc * (int32_t) oscs[1].rate;
-	inc = voicesInc[1];
-	incs[2] = inc * (int32_t) oscs[2].rate;
-	incs[3] = inc * (int32_t) oscs[3].rate;
-	inc = voicesInc[2];
-	incs[4] = inc * (int32_t) oscs[4].rate;
-	incs[5] = inc * (int32_t) oscs[5].rate;
-	inc = voicesInc[3];
-	incs[6] = inc * (int32_t) oscs[6].rate;
-	incs[7] = inc * (int32_t) oscs[7].rate;
+	uint32_t register incs[MAX_OSCS];
+	for (int j = 0; j < MAX_OSCS; j++)
+		incs[j] = voicesInc[j / VOICE_OSCS] * (int32_t) oscs[j].rate;
 
 	for (int i = 0; i < AUDIO_BUFFER_LEN / 2; i++) {
-		oscs[0].count += incs[0];
-		oscs[1].count += incs[1];
-		oscs[2].count += incs[2];
-		oscs[3].count += incs[3];
-		oscs[4].count += incs[4];
-		oscs[5].count += incs[5];
-		oscs[6].count += incs[6];
-		oscs[7].count += incs[7];
-
 		int16_t v = 0;
-		int16_t a = oscs[0].phase >> 16;
-		v += a >> oscs[0].shift;
-		int16_t b = oscs[1].phase >> 16;
-		v += b >> oscs[1].shift;
-		int16_t c = oscs[2].phase >> 16;
-		v += c >> oscs[2].shift;
-		int16_t d = oscs[3].phase >> 16;
-		v += d >> oscs[3].shift;
-		int16_t e = oscs[4].phase >> 16;
-		v += e >> oscs[4].shift;
-		int16_t f = oscs[5].phase >> 16;
-		v += f >> oscs[5].shift;
-		int16_t g = oscs[6].phase >> 16;
-		v += g >> oscs[6].shift;
-		int16_t h = oscs[7].phase >> 16;
-		v += h >> oscs[7].shift;
+		for (int j = 0; j < MAX_OSCS; j++) {
+			oscs[j].phase += incs[j];
+			int16_t a = oscs[j].phase >> 16;
+			v += a >> oscs[j].shift;
+		}
 
 		*buffer++ = 0;
 		*buffer++ = v;
@@ -25,22 +25,78 @@
 	#include "config.h"
 
 	#include <stdint.h>
+	#include <stdbool.h>
 
 /******************************************************************************/
 	#define MAX_VOICES		4
-	#define MAX_OSCS		(MAX_VOICES * 2)
-	#define GLIDE_SHIFT		3
+	#define VOICE_OSCS		2		// oscillators per para voice (1, 2 or 4)
+	#define MAX_OSCS		(MAX_VOICES * VOICE_OSCS)
+
+	#define RENDER_DIV		1		// oscillators rate divider (1, 2 or 4)
+	#define FRQ_RENDER		(FRQ_SAMPLE / RENDER_DIV)
+
+/*
+ * Para render cost per block of 64 frames (4096 cycles budget),
+ * oscillators rendered at 250, 125 or 62.5kHz (sample and hold):
+ *	oscs	voices x oscs		250kHz	125kHz	62.5kHz
+ *	4		4x1, 2x2, 1x4		1652	948		564
+ *	6		6x1, 3x2			2571	1483	907
+ *	8		8x1, 4x2, 2x4		3368	1896	1128
+ *	12		12x1, 6x2, 3x4		-		2844	1692
+ *	16		16x1, 8x2, 4x4		-		3792	2256
+ * The mono waves render 4 oscillators (1780, 1012, 596 cycles).
+ * Low latency blocks of 32 frames halve the budget but not the
+ * setup of the passes: 8 para oscillators take 1736 of 2048 cycles.
+ * The interrupt and the envelopes add about 120 cycles.
+ * Aliasing of a saw in the audio band, relative to the fundamental:
+ *	note	250kHz	125kHz	62.5kHz
+ *	A4		-33dB	-27dB	-21dB
+ *	A6		-27dB	-21dB	-16dB
+ *	C8		-24dB	-18dB	-12dB
+ */
+	#define GLIDE_SHIFT		3		// Default glide (1/2^n per update)
+	#define GLIDE_SHIFT_MAX	8
+	#define VIBRATO_RATE	393		// Default vibrato (~6Hz)
 	#define BEND_RANGE		7
 
+	typedef enum {
+		AUDIO_PRIORITY_LAST = 0,
+		AUDIO_PRIORITY_LOW,
+		AUDIO_PRIORITY_HIGH,
+	}AUDIO_PRIORITIES;
+
 /******************************************************************************/
 	extern int16_t audioBuffer[AUDIO_BUFFER_LEN * 2];
 
+/*
+ * Render interrupt timings, in words of the audio stream
+ * (32 cycles) after the start of the block: the entry
+ * latency and the end of the render, against the block
+ * length (AUDIO_BUFFER_LEN words). The mean is a moving
+ * average in 1/16 word. Late blocks were entered when the
+ * DMA was already reading the half to render.
+ */
+	typedef struct {
+		uint16_t entry, entryMax;
+		uint16_t exit, exitMin, exitMax;
+		uint16_t exitMean;
+		uint16_t overruns;
+		uint16_t late;
+	}AudioLoad;
+	extern volatile AudioLoad audioLoad;
+
 /******************************************************************************/
 	void audioInit();
 	void audioUpdate();
 	void audioRender(int16_t * buffer);
+	void audioEnvEvent();
+	uint16_t audioPosition();
+	bool audioLate(const int16_t * buffer);
+	void audioMeasure(uint16_t entry);
+	void audioResetLoad();
 
 	void audioNoteOn(uint8_t note);
+	void audioNotesOn(const uint8_t * notes, int count);
 	void audioNoteOff(uint8_t note);
 	void audioAllNotesOff();
 	void audioAllSoundsOff();
@@ -52,6 +108,10 @@
 	void audioSetBend(int16_t bend);
 	void audioSetCutoff(int16_t cutoff);
 	void audioSetWheel(int16_t wheel);
+	void audioSetPriority(int prio);
+	void audioSetGlide(int glide);
+	void audioSetVibratoRate(int rate);
+	int audioGetPriority();
 	
 	int audioGetNoVoices();
 	
@@ -31,10 +31,20 @@
 #define FRQ_MIDI			31250UL
 
 /** Buffer lengths */
-#define AUDIO_BUFFER_LEN	128
+//#define AUDIO_LOW_LATENCY			// 32 frames per block (128us)
+#ifdef AUDIO_LOW_LATENCY
+#define AUDIO_BUFFER_LEN	64
+#else
+#define AUDIO_BUFFER_LEN	128		// 64 frames per block (256us)
+#endif
 #define MIDIRX_BUFFER_LEN	64
 #define MIDIRX_BUFFER_MASK	(MIDIRX_BUFFER_LEN - 1)
 
+/** Main loop profiling (debug builds only) */
+#ifdef __DEBUG
+#define PROFILE
+#endif
+
 /** Other constants */
 #define NOTE_BASE			48
 #define TRACK_REF			60
@@ -43,4 +53,10 @@
 /** System ticks (milliseconds) */
 extern uint16_t uwTick;
 
+/** High resolution time (Timer1 counts, 4us) */
+#define FRQ_TIME			(FRQ_FCY / 64)
+#define TIME_PER_TICK		(FRQ_TIME / FRQ_TICK)
+extern volatile uint32_t uwTime;
+uint32_t timeNow();
+
 #endif
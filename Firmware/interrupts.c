@@ -30,28 +30,54 @@
 /******************************************************************************/
 void __attribute__((interrupt,no_auto_psv)) _DMA0Interrupt(void)
 {
+	uint16_t entry = audioPosition();
 	if (DMAINT0bits.HALFIF) {
+		if (audioLate(&audioBuffer[0])) audioLoad.late++;
 		audioRender(&audioBuffer[0]);
 		DMAINT0bits.HALFIF = 0;
 		DMAINT0bits.DONEIF = 0;
 	}
 
 	if (DMAINT0bits.DONEIF) {
+		if (audioLate(&audioBuffer[AUDIO_BUFFER_LEN])) audioLoad.late++;
 		audioRender(&audioBuffer[AUDIO_BUFFER_LEN]);
 		DMAINT0bits.HALFIF = 0;
 		DMAINT0bits.DONEIF = 0;
 	}
 
+	audioMeasure(entry);
+
 	IFS0bits.DMA0IF = 0;
 }
 
+void __attribute__((interrupt,no_auto_psv)) _CompInterrupt(void)
+{
+	audioEnvEvent();
+	CM1CONbits.CEVT = 0;
+	IFS1bits.CMIF = 0;
+}
+
 /******************************************************************************/
 void __attribute__((interrupt, no_auto_psv)) _T1Interrupt(void)
 {
 	uwTick++;
+	uwTime += TIME_PER_TICK;
 	IFS0bits.T1IF = 0;
 }
 
+uint32_t timeNow()
+{
+// Combine the tick count with Timer1
+	uint32_t base, time;
+	do {
+		base = uwTime;
+		time = base + TMR1;
+		if (IFS0bits.T1IF)
+			time = base + TIME_PER_TICK + TMR1;
+	} while (base != uwTime);
+	return time;
+}
+
 void __attribute__((interrupt, no_auto_psv)) _IOCInterrupt(void)
 {
 	if (IOCFAbits.IOCFA0) mseqExtClockStart();
@@ -24,6 +24,8 @@
 #include "audio.h"
 #include "store.h"
 #include "ui.h"
+#include "sched.h"
+#include "profile.h"
 
 #include "pins.h"
 #include "config.h"
@@ -33,6 +35,7 @@
 
 /******************************************************************************/
 uint16_t uwTick = 0;
+volatile uint32_t uwTime = 0;
 
 /******************************************************************************/
 int main(void)
@@ -45,13 +48,13 @@ int main(void)
 	audioInit();
 	mseqInit();
 	uiInit();
+	profileInit();
+	schedInit();
 
 // Program main loop
 	while (1) {
-		uiUpdate();
-		midiUpdate();
-		mseqUpdate();
-		audioUpdate();
+		profileLoop();
+		schedUpdate();
 	}
 
 	return 1;
@@ -34,6 +34,14 @@
 	#define MIDI_SYSEX_BEGIN			0xF0
 	#define MIDI_SYSEX_END				0xF7
 
+/* ZeKit - Sysex messages */
+	#define ZEKIT_SYSEX_ID				0x7D	// Non-commercial
+	#define ZEKIT_SYSEX_DEVICE			0x5A
+	#define ZEKIT_SYSEX_NONE			0x00
+	#define ZEKIT_SYSEX_PATTERN			0x01	// Pattern number, pattern
+	#define ZEKIT_SYSEX_GLOBALS			0x02	// Channel, clocking, tuning
+	#define ZEKIT_SYSEX_CC_MAP			0x03	// CC, parameter (none: defaults)
+
 /* MIDI - Realtime messages */
 	#define MIDI_TICK					0xF8
 	#define MIDI_START					0xFA
@@ -43,6 +51,7 @@
 
 /* MIDI - Standard CC numbers */
 	#define MIDI_CC_MODWHEEL			1
+	#define MIDI_CC_GLIDE				5
 	#define MIDI_CC_VOLUME				7
 	#define MIDI_CC_BALANCE				8
 	#define MIDI_CC_PAN					10
@@ -51,6 +60,19 @@
 	#define MIDI_CC_WAVE				70
 	#define MIDI_CC_PATTERN				71	
 	#define MIDI_CC_CUTOFF				74
+	#define MIDI_CC_VIBRATO_RATE		76
+	#define MIDI_CC_VIBRATO_DEPTH		77
+	#define MIDI_CC_CHAIN				80
+	#define MIDI_CC_CHAIN_EDIT			81
+	#define MIDI_CC_SWING				82
+	#define MIDI_CC_STEP_OFFSET			83
+	#define MIDI_CC_STEP_GATE			84
+	#define MIDI_CC_ARP					85
+	#define MIDI_CC_ARP_OCTAVES			86
+	#define MIDI_CC_NOTE_PRIORITY		87
+	#define MIDI_CC_SYSTEM				88
+	#define MIDI_CC_CLOCK_DIV			89
+	#define MIDI_CC_TEMPO				90
 	
 /* MIDI - Special CC numbers */
 	#define MIDI_CC_ALLSOUNDSOFF		120
@@ -25,6 +25,7 @@
 #include "audio.h"
 #include "store.h"
 #include "ui.h"
+#include "profile.h"
 
 #include "pins.h"
 #include "config.h"
@@ -41,9 +42,173 @@ static const uint8_t midiMsgLengths[] = {
 	2,	// 0xCx - Program change
 	2,	// 0xDx - Channel pressure
 	3,	// 0xEx - Pitch bend
-	1,	// 0xFx - Sysex / realtime
+};
+
+static const uint8_t midiCommonLengths[] = {
+	0,	// 0xF0 - Sysex begin
+	2,	// 0xF1 - Time code quarter frame
+	3,	// 0xF2 - Song position pointer
+	2,	// 0xF3 - Song select
+	1,	// 0xF4 - Undefined
+	1,	// 0xF5 - Undefined
+	1,	// 0xF6 - Tune request
+	0,	// 0xF7 - Sysex end
+};
+
+/*
+ * The parser is a state machine driven by a table: each
+ * received byte is classified, then the action is looked
+ * up from the current state and the byte class. Realtime
+ * bytes are handled in any state without changing it and
+ * a status byte aborts a pending sysex. Channel messages
+ * and realtime bytes, most of the traffic, skip the table.
+ */
+typedef enum {
+	MIDI_CLASS_DATA = 0,
+	MIDI_CLASS_VOICE,
+	MIDI_CLASS_COMMON,
+	MIDI_CLASS_SYSEX,
+	MIDI_CLASS_EOX,
+	MIDI_CLASS_REALTIME,
+	MIDI_CLASSES,
+}MIDI_CLASSES_ENUM;
+
+typedef enum {
+	MIDI_STATE_IDLE = 0,	// No running status
+	MIDI_STATE_VOICE,		// Channel message (running status)
+	MIDI_STATE_COMMON,		// System common message
+	MIDI_STATE_SYSEX,		// System exclusive
+	MIDI_STATES,
+}MIDI_STATES_ENUM;
+
+typedef enum {
+	MIDI_ACT_NONE = 0,
+	MIDI_ACT_REALTIME,
+	MIDI_ACT_VOICE,
+	MIDI_ACT_COMMON,
+	MIDI_ACT_DATA,
+	MIDI_ACT_SYSEX,
+	MIDI_ACT_SYSEX_DATA,
+	MIDI_ACT_SYSEX_END,
+	MIDI_ACT_RESET,
+	MIDI_ACT_ABORT = 0x80,	// Abort the pending sysex first
+}MIDI_ACTIONS;
+
+static const uint8_t midiSystemClasses[16] = {
+	MIDI_CLASS_SYSEX,		// 0xF0
+	MIDI_CLASS_COMMON,		// 0xF1
+	MIDI_CLASS_COMMON,		// 0xF2
+	MIDI_CLASS_COMMON,		// 0xF3
+	MIDI_CLASS_COMMON,		// 0xF4
+	MIDI_CLASS_COMMON,		// 0xF5
+	MIDI_CLASS_COMMON,		// 0xF6
+	MIDI_CLASS_EOX,			// 0xF7
+	MIDI_CLASS_REALTIME,	// 0xF8
+	MIDI_CLASS_REALTIME,	// 0xF9
+	MIDI_CLASS_REALTIME,	// 0xFA
+	MIDI_CLASS_REALTIME,	// 0xFB
+	MIDI_CLASS_REALTIME,	// 0xFC
+	MIDI_CLASS_REALTIME,	// 0xFD
+	MIDI_CLASS_REALTIME,	// 0xFE
+	MIDI_CLASS_REALTIME,	// 0xFF
+};
+
+static const uint8_t midiActions[MIDI_STATES][MIDI_CLASSES] = {
+// Data						Voice							Common								Sysex							EOX						Realtime
+	{MIDI_ACT_NONE,			MIDI_ACT_VOICE,					MIDI_ACT_COMMON,					MIDI_ACT_SYSEX,					MIDI_ACT_NONE,			MIDI_ACT_REALTIME},	// Idle
+	{MIDI_ACT_DATA,			MIDI_ACT_VOICE,					MIDI_ACT_COMMON,					MIDI_ACT_SYSEX,					MIDI_ACT_RESET,			MIDI_ACT_REALTIME},	// Voice
+	{MIDI_ACT_DATA,			MIDI_ACT_VOICE,					MIDI_ACT_COMMON,					MIDI_ACT_SYSEX,					MIDI_ACT_RESET,			MIDI_ACT_REALTIME},	// Common
+	{MIDI_ACT_SYSEX_DATA,	MIDI_ACT_ABORT|MIDI_ACT_VOICE,	MIDI_ACT_ABORT|MIDI_ACT_COMMON,		MIDI_ACT_ABORT|MIDI_ACT_SYSEX,	MIDI_ACT_SYSEX_END,		MIDI_ACT_REALTIME},	// Sysex
 };
 
+/******************************************************************************/
+/*
+ * Control changes are dispatched through a map from the
+ * CC number to a parameter handler. The map can be changed
+ * by sysex and is kept in flash.
+ */
+typedef void (*MidiCCHandler)(uint8_t value);
+
+static void midiCCNone(uint8_t value);
+static void midiCCWheel(uint8_t value);
+static void midiCCWave(uint8_t value);
+static void midiCCPattern(uint8_t value);
+static void midiCCCutoff(uint8_t value);
+static void midiCCChain(uint8_t value);
+static void midiCCChainEdit(uint8_t value);
+static void midiCCSwing(uint8_t value);
+static void midiCCStepOffset(uint8_t value);
+static void midiCCStepGate(uint8_t value);
+static void midiCCArp(uint8_t value);
+static void midiCCArpOctaves(uint8_t value);
+static void midiCCNotePriority(uint8_t value);
+static void midiCCGlide(uint8_t value);
+static void midiCCVibratoRate(uint8_t value);
+static void midiCCVibratoDepth(uint8_t value);
+static void midiCCSystem(uint8_t value);
+static void midiCCClockDiv(uint8_t value);
+static void midiCCTempo(uint8_t value);
+static void midiCCAllSoundsOff(uint8_t value);
+static void midiCCResetCtrls(uint8_t value);
+static void midiCCAllNotesOff(uint8_t value);
+
+static const MidiCCHandler midiCCHandlers[MIDI_PARAMS] = {
+	[MIDI_PARAM_NONE]			= midiCCNone,
+	[MIDI_PARAM_WHEEL]			= midiCCWheel,
+	[MIDI_PARAM_WAVE]			= midiCCWave,
+	[MIDI_PARAM_PATTERN]		= midiCCPattern,
+	[MIDI_PARAM_CUTOFF]			= midiCCCutoff,
+	[MIDI_PARAM_CHAIN]			= midiCCChain,
+	[MIDI_PARAM_CHAIN_EDIT]		= midiCCChainEdit,
+	[MIDI_PARAM_SWING]			= midiCCSwing,
+	[MIDI_PARAM_STEP_OFFSET]	= midiCCStepOffset,
+	[MIDI_PARAM_STEP_GATE]		= midiCCStepGate,
+	[MIDI_PARAM_ARP]			= midiCCArp,
+	[MIDI_PARAM_ARP_OCTAVES]	= midiCCArpOctaves,
+	[MIDI_PARAM_NOTE_PRIORITY]	= midiCCNotePriority,
+	[MIDI_PARAM_GLIDE]			= midiCCGlide,
+	[MIDI_PARAM_VIBRATO_RATE]	= midiCCVibratoRate,
+	[MIDI_PARAM_VIBRATO_DEPTH]	= midiCCVibratoDepth,
+	[MIDI_PARAM_SYSTEM]			= midiCCSystem,
+	[MIDI_PARAM_CLOCK_DIV]		= midiCCClockDiv,
+	[MIDI_PARAM_TEMPO]			= midiCCTempo,
+	[MIDI_PARAM_ALLSOUNDSOFF]	= midiCCAllSoundsOff,
+	[MIDI_PARAM_RESETCTRLS]		= midiCCResetCtrls,
+	[MIDI_PARAM_ALLNOTESOFF]	= midiCCAllNotesOff,
+};
+
+static const uint8_t midiCCDefaults[][2] = {
+	{MIDI_CC_MODWHEEL,			MIDI_PARAM_WHEEL},
+	{MIDI_CC_GLIDE,				MIDI_PARAM_GLIDE},
+	{MIDI_CC_WAVE,				MIDI_PARAM_WAVE},
+	{MIDI_CC_PATTERN,			MIDI_PARAM_PATTERN},
+	{MIDI_CC_CUTOFF,			MIDI_PARAM_CUTOFF},
+	{MIDI_CC_VIBRATO_RATE,		MIDI_PARAM_VIBRATO_RATE},
+	{MIDI_CC_VIBRATO_DEPTH,		MIDI_PARAM_VIBRATO_DEPTH},
+	{MIDI_CC_CHAIN,				MIDI_PARAM_CHAIN},
+	{MIDI_CC_CHAIN_EDIT,		MIDI_PARAM_CHAIN_EDIT},
+	{MIDI_CC_SWING,				MIDI_PARAM_SWING},
+	{MIDI_CC_STEP_OFFSET,		MIDI_PARAM_STEP_OFFSET},
+	{MIDI_CC_STEP_GATE,			MIDI_PARAM_STEP_GATE},
+	{MIDI_CC_ARP,				MIDI_PARAM_ARP},
+	{MIDI_CC_ARP_OCTAVES,		MIDI_PARAM_ARP_OCTAVES},
+	{MIDI_CC_NOTE_PRIORITY,		MIDI_PARAM_NOTE_PRIORITY},
+	{MIDI_CC_SYSTEM,			MIDI_PARAM_SYSTEM},
+	{MIDI_CC_CLOCK_DIV,			MIDI_PARAM_CLOCK_DIV},
+	{MIDI_CC_TEMPO,				MIDI_PARAM_TEMPO},
+	{MIDI_CC_ALLSOUNDSOFF,		MIDI_PARAM_ALLSOUNDSOFF},
+	{MIDI_CC_RESETCTRLS,		MIDI_PARAM_RESETCTRLS},
+	{MIDI_CC_ALLNOTESOFF,		MIDI_PARAM_ALLNOTESOFF},
+};
+
+#define MIDI_CCMAP_MAGIC	0x50414D43UL	// "CMAP"
+
+static uint8_t midiCCMap[128];
+
+static void midiLoadMap();
+static void midiSaveMap();
+static void midiDefaultMap();
+
 /******************************************************************************/
 uint16_t midiBuffer[MIDIRX_BUFFER_LEN];	// DMA RX buffer
 
@@ -51,9 +216,23 @@ uint16_t midiBuffer[MIDIRX_BUFFER_LEN];	// DMA RX buffer
 static uint8_t	midiChannel;
 
 static uint16_t midiRd;
+static uint8_t	midiState;
 static uint8_t	midiBytes[4];
 static uint16_t midiLength;
 static uint16_t midiCount;
+static uint16_t midiSysExLength;
+static uint8_t	midiSysExCommand;
+static uint8_t	midiSysExNibble;
+static uint8_t	midiSysExSum;
+static uint8_t	midiSysExData[3];
+static uint16_t midiSysExCount;
+
+static void midiParse(uint8_t b);
+static void midiRealtime(uint8_t b);
+static void midiMessage();
+static void midiSysExBegin();
+static void midiSysExByte(uint8_t b);
+static void midiSysExEnd(bool complete);
 
 static void midiNoteOn(uint8_t note, uint8_t velo);
 static void midiNoteOff(uint8_t note, uint8_t velo);
@@ -64,109 +243,377 @@ void midiInit()
 	midiChannel = 0;
 	
 	midiRd = 0;
+	midiState = MIDI_STATE_IDLE;
 	midiBytes[0] = 0;
 	midiBytes[1] = 0;
 	midiBytes[2] = 0;
 	midiBytes[3] = 0;
 	midiLength = 0;
 	midiCount = 0;
+	midiSysExLength = 0;
+
+	midiLoadMap();
 }
 
+/*
+ * Parser cost model (cycles per byte, handlers excluded):
+ *	ring read, channel status or data byte			~30
+ *	system bytes: classify, action lookup, jump		~40
+ *	realtime clock (MIDI clock countdown)			~55
+ *	data byte, message pending						~35
+ *	message complete, off channel					~60
+ *	note on / off, on channel (with voices)			300 to 700
+ *	control change, table dispatch					~75 + handler
+ * A full MIDI stream is 3125 bytes/s (320us per byte). The
+ * render interrupt takes ~85% of the CPU with 8 para oscs
+ * at 250kHz, which leaves ~2.4M cycles/s to the main loop.
+ * Dense running status notes (1562 notes/s) then use less
+ * than half of it, 24 PPQN clocks are negligible. A full
+ * ring (64 bytes) drains in ~1.6ms of off channel traffic
+ * and ~9ms of on channel notes, against 20ms to fill it.
+ * Debug builds measure the real cost (profile.midi).
+ */
 void midiUpdate()
 {
 	int dmaRd = MIDIRX_BUFFER_LEN - DMACNT1;
 	int len = (dmaRd - midiRd) & MIDIRX_BUFFER_MASK;
+#ifdef PROFILE
+	uint32_t start = profileCycles();
+#endif
 
 	for (int i = 0; i < len; i++) {
 		uint8_t b = midiBuffer[midiRd];
 		midiRd = (midiRd + 1) & MIDIRX_BUFFER_MASK;
+		midiParse(b);
+	}
+
+#ifdef PROFILE
+	profileMIDI(len, profileCycles() - start);
+#endif
+}
 
-	// Realtime messages
-		if ((b & 0xF8) == 0xF8) {
-			switch(b) {
-			case MIDI_TICK: mseqMIDITick(); break;
-			case MIDI_START: mseqMIDIStart(); break;
-			case MIDI_CONTINUE: mseqMIDIContinue(); break;
-			case MIDI_STOP: mseqMIDIStop(); break;
-			default: break;
-			} continue;
-		}
-
-	// New MIDI status
-		if (b & 0x80) {
-			midiBytes[0] = b;
-			midiLength = midiMsgLengths[(b >> 4) & 0x7];
-			midiCount = 1;
-		}else{
-			midiBytes[midiCount++] = b;
-			if (midiCount >= 3) midiCount = 3;
-		}
-
-	/* Parse a complete message */
-		if (!midiBytes[0]) continue;
-		if (midiBytes[0] == MIDI_SYSEX_BEGIN) continue;
-		if (midiBytes[0] == MIDI_SYSEX_END) continue;
-
-		if (midiCount == midiLength) {
-			midiCount = 1;
-			int status = midiBytes[0] & 0xF0;
-			int channel = midiBytes[0] & 0x0F;
-			if (channel != midiChannel) continue;
-
-			switch(status) {
-			case MIDI_NOTE_ON:
-				if (midiBytes[2])
-					midiNoteOn(midiBytes[1], midiBytes[2]);
-				else midiNoteOff(midiBytes[1], 0);
-				break;
-
-			case MIDI_NOTE_OFF:
-				midiNoteOff(midiBytes[1], midiBytes[2]);
-				break;
-
-			case MIDI_CC:
-
-				switch(midiBytes[1]) {
-				case MIDI_CC_MODWHEEL:
-					audioSetWheel(midiBytes[2]);
-					uiFRCTuning(midiBytes[2]);
-					break;
-
-				case MIDI_CC_WAVE:
-					audioSetWave(midiBytes[2] >> 3);
-					break;
-				
-				case MIDI_CC_PATTERN:
-					mseqSetPattern(midiBytes[2] >> 3);
-					break;
-
-				case MIDI_CC_CUTOFF:
-					audioSetCutoff(midiBytes[2]);
-					break;
-					
-				case MIDI_CC_ALLNOTESOFF:
-					audioAllNotesOff();
-					break;
-
-				case MIDI_CC_ALLSOUNDSOFF:
-					audioAllSoundsOff();
-					break;
-
-				case MIDI_CC_RESETCTRLS:
-					audioResetCtrls();
-					break;
-
-				default: break;
-				}
-				break;
-
-			case MIDI_PITCHBEND:
-				audioSetBend((midiBytes[2] << 7) | midiBytes[1]);
-				break;
-
-			default: break;
-			}
-		}
+bool midiPending()
+{
+	int dmaRd = MIDIRX_BUFFER_LEN - DMACNT1;
+	return ((dmaRd - midiRd) & MIDIRX_BUFFER_MASK) != 0;
+}
+
+
+/******************************************************************************/
+void midiParse(uint8_t b)
+{
+// Channel messages and realtime bytes first
+	if (b < 0x80 && midiState == MIDI_STATE_VOICE) {
+		midiBytes[midiCount++] = b;
+		if (midiCount < midiLength) return;
+		midiCount = 1;
+		midiMessage();
+		return;
+	}
+	if (b >= 0xF8) {
+		midiRealtime(b);
+		return;
+	}
+	if (b >= 0x80 && b < 0xF0 && midiState != MIDI_STATE_SYSEX) {
+		midiBytes[0] = b;
+		midiLength = midiMsgLengths[(b >> 4) & 0x7];
+		midiCount = 1;
+		midiState = MIDI_STATE_VOICE;
+		return;
+	}
+
+// Classify the byte
+	uint8_t type = MIDI_CLASS_DATA;
+	if (b >= 0xF0) type = midiSystemClasses[b & 0x0F];
+	else if (b & 0x80) type = MIDI_CLASS_VOICE;
+
+// Apply the action
+	uint8_t action = midiActions[midiState][type];
+	if (action & MIDI_ACT_ABORT)
+		midiSysExEnd(false);
+
+	switch (action & ~MIDI_ACT_ABORT) {
+	case MIDI_ACT_REALTIME:
+		midiRealtime(b);
+		break;
+
+	case MIDI_ACT_VOICE:
+		midiBytes[0] = b;
+		midiLength = midiMsgLengths[(b >> 4) & 0x7];
+		midiCount = 1;
+		midiState = MIDI_STATE_VOICE;
+		break;
+
+	case MIDI_ACT_COMMON:
+		midiBytes[0] = b;
+		midiLength = midiCommonLengths[b & 0x7];
+		midiCount = 1;
+		midiState = midiLength > 1 ? MIDI_STATE_COMMON : MIDI_STATE_IDLE;
+		break;
+
+	case MIDI_ACT_DATA:
+		midiBytes[midiCount++] = b;
+		if (midiCount < midiLength) break;
+		midiCount = 1;
+		if (midiState == MIDI_STATE_VOICE) midiMessage();
+		else midiState = MIDI_STATE_IDLE;
+		break;
+
+	case MIDI_ACT_SYSEX:
+		midiSysExBegin();
+		midiState = MIDI_STATE_SYSEX;
+		break;
+
+	case MIDI_ACT_SYSEX_DATA:
+		midiSysExByte(b);
+		break;
+
+	case MIDI_ACT_SYSEX_END:
+		midiSysExEnd(true);
+		midiState = MIDI_STATE_IDLE;
+		break;
+
+	case MIDI_ACT_RESET:
+		midiState = MIDI_STATE_IDLE;
+		break;
+
+	default: break;
+	}
+}
+
+void midiRealtime(uint8_t b)
+{
+	switch(b) {
+	case MIDI_TICK: mseqMIDITick(); break;
+	case MIDI_START: mseqMIDIStart(); break;
+	case MIDI_CONTINUE: mseqMIDIContinue(); break;
+	case MIDI_STOP: mseqMIDIStop(); break;
+	default: break;
+	}
+}
+
+void midiMessage()
+{
+	int status = midiBytes[0] & 0xF0;
+	int channel = midiBytes[0] & 0x0F;
+	if (channel != midiChannel) return;
+
+	switch(status) {
+	case MIDI_NOTE_ON:
+		if (midiBytes[2])
+			midiNoteOn(midiBytes[1], midiBytes[2]);
+		else midiNoteOff(midiBytes[1], 0);
+		break;
+
+	case MIDI_NOTE_OFF:
+		midiNoteOff(midiBytes[1], midiBytes[2]);
+		break;
+
+	case MIDI_CC:
+		midiCCHandlers[midiCCMap[midiBytes[1]]](midiBytes[2]);
+		break;
+
+	case MIDI_PITCHBEND:
+		audioSetBend((midiBytes[2] << 7) | midiBytes[1]);
+		break;
+
+	default: break;
+	}
+}
+
+/******************************************************************************/
+/*
+ * ZeKit sysex messages: F0 7D 5A <command> [<pattern>]
+ * <payload> <checksum> F7. Payload bytes are sent as two
+ * nibbles, high first. The checksum is the 7-bit sum of
+ * the pattern number and the payload bytes.
+ */
+#define MIDI_SYSEX_HEADER	3
+#define MIDI_SYSEX_FOREIGN	0xFFFF	// Not a ZeKit message
+#define MIDI_NIBBLE_NONE	0xFF
+
+void midiSysExBegin()
+{
+	midiSysExLength = 0;
+	midiSysExCommand = ZEKIT_SYSEX_NONE;
+	midiSysExNibble = MIDI_NIBBLE_NONE;
+	midiSysExSum = 0;
+	midiSysExCount = 0;
+}
+
+void midiSysExByte(uint8_t b)
+{
+// Message header
+	uint16_t pos = midiSysExLength;
+	if (pos <= MIDI_SYSEX_HEADER) midiSysExLength++;
+	switch (pos) {
+	case 0:
+		if (b != ZEKIT_SYSEX_ID) midiSysExLength = MIDI_SYSEX_FOREIGN;
+		return;
+	case 1:
+		if (b != ZEKIT_SYSEX_DEVICE) midiSysExLength = MIDI_SYSEX_FOREIGN;
+		return;
+	case 2:
+		midiSysExCommand = b;
+		return;
+	case 3:
+		if (midiSysExCommand != ZEKIT_SYSEX_PATTERN) break;
+		midiSysExSum = b;
+		mseqImportBegin(b);
+		return;
+	case MIDI_SYSEX_FOREIGN:
+		return;
+	default: break;
+	}
+
+// Payload nibbles
+	if (midiSysExNibble == MIDI_NIBBLE_NONE) {
+		midiSysExNibble = b;
+		return;
+	}
+	uint8_t data = (midiSysExNibble << 4) | (b & 0x0F);
+	midiSysExNibble = MIDI_NIBBLE_NONE;
+	midiSysExSum += data;
+
+	if (midiSysExCommand == ZEKIT_SYSEX_PATTERN)
+		mseqImportByte(data);
+	else if (midiSysExCount < sizeof(midiSysExData))
+		midiSysExData[midiSysExCount] = data;
+	midiSysExCount++;
+}
+
+void midiSysExEnd(bool complete)
+{
+// Checksum is the odd byte left
+	bool valid = complete && midiSysExLength > MIDI_SYSEX_HEADER && midiSysExLength != MIDI_SYSEX_FOREIGN;
+	valid = valid && midiSysExNibble == (midiSysExSum & 0x7F);
+
+	switch (midiSysExCommand) {
+	case ZEKIT_SYSEX_PATTERN:
+		if (midiSysExLength > MIDI_SYSEX_HEADER && midiSysExLength != MIDI_SYSEX_FOREIGN)
+			mseqImportEnd(valid);
+		break;
+
+	case ZEKIT_SYSEX_GLOBALS:
+		if (!valid || midiSysExCount != 3) break;
+		uiSetGlobals(midiSysExData[0], midiSysExData[1], midiSysExData[2]);
+		break;
+
+	case ZEKIT_SYSEX_CC_MAP:
+		if (!valid) break;
+		if (midiSysExCount == 2) midiSetMap(midiSysExData[0], midiSysExData[1]);
+		else if (midiSysExCount == 0) midiResetMap();
+		break;
+
+	default: break;
+	}
+	midiSysExLength = 0;
+	midiSysExCommand = ZEKIT_SYSEX_NONE;
+}
+
+/******************************************************************************/
+void midiCCNone(uint8_t value) {}
+
+void midiCCWheel(uint8_t value)
+{
+	audioSetWheel(value);
+	uiFRCTuning(value);
+}
+
+void midiCCWave(uint8_t value) {audioSetWave(value >> 3);}
+void midiCCPattern(uint8_t value) {mseqSetPattern(value >> 1);}
+void midiCCCutoff(uint8_t value) {audioSetCutoff(value);}
+void midiCCChain(uint8_t value) {mseqSetChain(value >= 64);}
+
+void midiCCChainEdit(uint8_t value)
+{
+	if (!value) mseqChainClear();
+	else mseqChainAppend(mseqGetPattern(), value);
+}
+
+void midiCCSwing(uint8_t value) {mseqSetSwing(value);}
+void midiCCStepOffset(uint8_t value) {mseqSetOffset(value);}
+void midiCCStepGate(uint8_t value) {mseqSetGate(value << 1);}
+void midiCCArp(uint8_t value) {mseqSetArp(value >> 4);}
+void midiCCArpOctaves(uint8_t value) {mseqSetArpOctaves((value >> 5) + 1);}
+void midiCCNotePriority(uint8_t value) {audioSetPriority(value >> 5);}
+void midiCCGlide(uint8_t value) {audioSetGlide(value);}
+void midiCCVibratoRate(uint8_t value) {audioSetVibratoRate(value);}
+void midiCCVibratoDepth(uint8_t value) {audioSetWheel(value);}
+void midiCCSystem(uint8_t value) {uiSystem = value >> 3;}
+
+void midiCCClockDiv(uint8_t value)
+{
+// Three divider settings over the CC range
+	int clocking = mseqGetClocking() & MSEQ_CLOCK_TAKE_BOTH;
+	int div = value < 43 ? MSEQ_CLOCK_DIV_0 : value < 86 ? MSEQ_CLOCK_DIV_2 : MSEQ_CLOCK_DIV_4;
+	mseqSetClocking(clocking | div);
+}
+
+void midiCCTempo(uint8_t value) {mseqSetTempo(60 + value);}
+void midiCCAllSoundsOff(uint8_t value) {audioAllSoundsOff();}
+void midiCCResetCtrls(uint8_t value) {audioResetCtrls();}
+void midiCCAllNotesOff(uint8_t value) {audioAllNotesOff();}
+
+/******************************************************************************/
+void midiSetMap(uint8_t cc, uint8_t param)
+{
+	if (cc >= 128 || param >= MIDI_PARAMS) return;
+	if (midiCCMap[cc] == param) return;
+	midiCCMap[cc] = param;
+	midiSaveMap();
+}
+
+void midiResetMap()
+{
+	midiDefaultMap();
+	midiSaveMap();
+}
+
+void midiDefaultMap()
+{
+	for (int i = 0; i < 128; i++)
+		midiCCMap[i] = MIDI_PARAM_NONE;
+	int count = sizeof(midiCCDefaults) / sizeof(midiCCDefaults[0]);
+	for (int i = 0; i < count; i++)
+		midiCCMap[midiCCDefaults[i][0]] = midiCCDefaults[i][1];
+}
+
+void midiLoadMap()
+{
+// Factory map when never saved
+	uint32_t header;
+	storeRead32(CCMAP_ADDR, &header);
+	if (header != MIDI_CCMAP_MAGIC) {
+		midiDefaultMap();
+		return;
+	}
+
+// Load and sanitize the map
+	uint32_t addr = CCMAP_ADDR + 4;
+	for (int i = 0; i < 128; i += 4) {
+		uint32_t dword;
+		uint8_t * params = (uint8_t *) &dword;
+		storeRead32(addr, &dword);
+		for (int j = 0; j < 4; j++)
+			midiCCMap[i + j] = params[j] < MIDI_PARAMS ? params[j] : MIDI_PARAM_NONE;
+		addr += 4;
+	}
+}
+
+void midiSaveMap()
+{
+	uint32_t header = MIDI_CCMAP_MAGIC;
+	storeErasePage(CCMAP_ADDR);
+	storeWrite32(CCMAP_ADDR, &header);
+	uint32_t addr = CCMAP_ADDR + 4;
+	for (int i = 0; i < 128; i += 4) {
+		uint32_t dword;
+		uint8_t * params = (uint8_t *) &dword;
+		for (int j = 0; j < 4; j++)
+			params[j] = midiCCMap[i + j];
+		storeWrite32(addr, &dword);
+		addr += 4;
 	}
 }
 
@@ -23,14 +23,47 @@
 
 	#include "config.h"
 	#include <stdint.h>
+	#include <stdbool.h>
+
+/******************************************************************************/
+/* Parameters reachable by CC (remappable) */
+	typedef enum {
+		MIDI_PARAM_NONE = 0,
+		MIDI_PARAM_WHEEL,
+		MIDI_PARAM_WAVE,
+		MIDI_PARAM_PATTERN,
+		MIDI_PARAM_CUTOFF,
+		MIDI_PARAM_CHAIN,
+		MIDI_PARAM_CHAIN_EDIT,
+		MIDI_PARAM_SWING,
+		MIDI_PARAM_STEP_OFFSET,
+		MIDI_PARAM_STEP_GATE,
+		MIDI_PARAM_ARP,
+		MIDI_PARAM_ARP_OCTAVES,
+		MIDI_PARAM_NOTE_PRIORITY,
+		MIDI_PARAM_GLIDE,
+		MIDI_PARAM_VIBRATO_RATE,
+		MIDI_PARAM_VIBRATO_DEPTH,
+		MIDI_PARAM_SYSTEM,
+		MIDI_PARAM_CLOCK_DIV,
+		MIDI_PARAM_TEMPO,
+		MIDI_PARAM_ALLSOUNDSOFF,
+		MIDI_PARAM_RESETCTRLS,
+		MIDI_PARAM_ALLNOTESOFF,
+		MIDI_PARAMS,
+	}MIDI_PARAMS_ENUM;
 
 /******************************************************************************/
 	extern uint16_t midiBuffer[MIDIRX_BUFFER_LEN];
 
 	void midiInit();
 	void midiUpdate();
+	bool midiPending();
 
 	void midiSetChannel(int channel);
 	int  midiGetChannel();
+
+	void midiSetMap(uint8_t cc, uint8_t param);
+	void midiResetMap();
 	
 #endif
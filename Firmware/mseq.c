@@ -36,13 +36,23 @@ typedef struct {
 	uint8_t state;
 	uint16_t dt, plldt, stamp;
 	uint16_t tick;
+	uint16_t updated;		// Last update (ticks)
 
 	uint8_t	pattern;
 	uint8_t	nextPattern;
 	uint8_t	step;
 	bool halfStep;
 
+	bool gridRunning;
+	uint16_t gridPos;		// Half-step position
+	uint32_t gridTime;		// Half-step start (timebase)
+	uint32_t gridPeriod;	// Half-step duration (timebase)
+	uint16_t donePos;		// Events dispatched so far
+
 	bool mustClear;
+	bool mustCompile;
+	bool mustPrefetch;
+	bool mustRewind;
 
 	uint8_t	root;
 } Sequencer;
@@ -50,37 +60,238 @@ Sequencer seq;
 
 static void seqHome();
 static void seqClean();
+static void seqClockStamp();
 static void seqPlay();
+static void seqReleaseSlots();
+static void seqCompile();
+static void seqPrefetch();
+static void seqSwitch();
+static void seqDispatch(bool flush);
+static bool seqDue(uint16_t pos, uint32_t elapsed);
+static uint16_t seqPosition(uint32_t time);
 
 static void seqPlayBlinkFlash();
 static void seqRecBlinkFlash();
 static void seqTapBlinkFlash();
 static void seqSaveBlinkFlash();
 
-static void seqPatternsDefault();
-static void seqPatternsLoad();
-static void seqPatternsSave(int id);
-
 /*****************************************************************************/
 // Internal pattern related functions
 #define STEP_EMPTY	0x80
 #define STEP_TIE	0x81
 
+/*
+ * Steps are stored with a variable length: one mask byte
+ * (2 bits per note slot: empty, note or tie) followed by
+ * the notes actually present, in slot order.
+ */
+#define SLOT_EMPTY	0x0
+#define SLOT_NOTE	0x1
+#define SLOT_TIE	0x2
+#define SLOT_BITS	0x3
+
+#define PATTERN_COMPACT		0x80	// Flash record encoding
+#define PATTERN_TIMING		0x40	// Swing and offsets follow
+#define PATTERN_GATES		0x20	// Gate lengths follow
+#define PATTERN_DATA_MAX	(SEQ_STEPS_MAX * (1 + SEQ_NOTES_MAX))
+#define PATTERN_BLOCK_MAX	(2 * SEQ_STEPS_MAX + PATTERN_DATA_MAX)
+#define PATTERN_NONE		0xFF
+
 typedef struct {
 	uint8_t root;
 	uint8_t length;
 	uint8_t id;
 	uint8_t flags;
-	uint8_t notes[SEQ_STEPS_MAX][SEQ_NOTES_MAX];
+	uint16_t size;		// Step data size (bytes)
+	uint16_t base;		// Block in the pool
+	bool dirty;			// Recorded, not saved yet
+	uint8_t swing;		// Odd steps delay (1/256 step)
 } Pattern;
-Pattern patterns[SEQ_PATTERNS_MAX];
 
+/*
+ * Patterns live in flash and are fetched in a small
+ * RAM cache: the playing pattern, the queued pattern
+ * and one spare slot keeping unsaved recordings.
+ * The last header stages the imported patterns.
+ * Their step offsets, gates and data are packed in a
+ * shared pool, one block per pattern. The pool holds
+ * two patterns of any size: when it is full, the other
+ * patterns are evicted (the queued one last) and the
+ * import in progress is dropped.
+ */
+#define SEQ_POOL_SIZE	(2 * PATTERN_BLOCK_MAX)
+
+static Pattern patternsCache[SEQ_CACHE_SLOTS + 1];
+static Pattern * const importPattern = &patternsCache[SEQ_CACHE_SLOTS];
+static uint8_t seqPool[SEQ_POOL_SIZE];
+static uint16_t seqPoolUsed;
+static Pattern * seqCurrent;
+static Pattern * seqQueued;
+
+static Pattern * seqPatternFetch(int id);
+static Pattern * seqPatternSpare();
+static void seqPatternEvict(Pattern * p);
+static void seqPatternsLoad(Pattern * p);
+static void seqPatternsSave(Pattern * p);
+
+static bool poolReserve(Pattern * p, uint16_t bytes);
+static void poolResize(Pattern * p, uint16_t at, int delta);
+
+static uint8_t * patternOffsets(const Pattern * p);
+static uint8_t * patternGates(const Pattern * p);
+static uint8_t * patternData(const Pattern * p);
+static bool patternAlloc(Pattern * p);
+static void patternFree(Pattern * p);
+static void patternDefault(Pattern * p);
 static void patternClear(Pattern * p);
 static void patternInsert(Pattern * p, uint8_t note);
 static void patternAdvance(Pattern * p);
+static bool patternAppend(Pattern * p, const uint8_t * notes);
+static const uint8_t * patternDecode(const uint8_t * src, uint8_t * notes);
+static int patternEncode(const uint8_t * notes, uint8_t * dst);
+static int patternDelay(const Pattern * p, int step);
+static int patternFind(const Pattern * p, int step);
+static bool patternSetSlot(Pattern * p, int step, int slot, uint8_t note);
+static uint32_t patternRead(uint32_t addr, uint8_t * dst, int count);
+static uint32_t patternWrite(uint32_t addr, const uint8_t * src, int count);
+static uint8_t patternFlags(const Pattern * p);
+static uint32_t patternRecord(uint32_t size, uint8_t length, uint8_t flags);
+static uint32_t patternNext(uint32_t addr);
 static void patternLoad(uint32_t addr, Pattern * p);
+static void patternLoadLegacy(uint32_t addr, Pattern * p);
 static void patternSave(uint32_t addr, const Pattern * p);
 
+/*****************************************************************************/
+// Compiled pattern timeline
+/*
+ * Events are placed at 1/256 of a step and played
+ * against the half-step grid given by the clock: an
+ * event is due when the fraction of the half-step
+ * elapsed on the timebase reaches its position.
+ * Each note carries its gate length, ties included,
+ * and is released by its slot once the gate is over.
+ * The playing and the prefetched timelines share a pool
+ * of events from both ends, sized by the notes of their
+ * pattern. When the queued pattern does not fit next to
+ * the playing one, it is compiled at the pattern end.
+ */
+#define SEQ_EVENTS_MAX	(SEQ_STEPS_MAX * SEQ_NOTES_MAX)
+#define SEQ_EVENTS_POOL	(SEQ_EVENTS_MAX + SEQ_EVENTS_MAX / 4 + 2)
+#define SEQ_STEP_RES	256
+#define SEQ_HALF_RES	(SEQ_STEP_RES / 2)
+#define EVENT_END		0xFFFF
+
+typedef struct {
+	uint16_t pos;		// Position (1/256 step)
+	uint16_t gate;		// Length (1/256 step)
+	uint8_t slot;		// Note slot
+	uint8_t note;		// Transposed note
+} Event;
+
+typedef struct {
+	Event * events;
+	const Event * next;
+	uint16_t count;		// Events and end mark (0: none)
+	bool top;			// At the end of the pool
+} Timeline;
+static Event seqEvents[SEQ_EVENTS_POOL];
+static Timeline timelines[2];
+static Timeline * timeline;
+static Timeline * timelineNext;
+static uint8_t timelineNextPattern;
+
+static uint16_t timelineCount(const Pattern * p);
+static bool timelinePlace(Timeline * t, uint16_t count);
+static void timelineCompile(Timeline * t, const Pattern * p, uint8_t root);
+static void timelineSeek(Timeline * t, uint16_t pos);
+
+/*****************************************************************************/
+// Song / chain of patterns
+typedef struct {
+	uint8_t pattern;
+	uint8_t repeats;
+} ChainLink;
+
+typedef struct {
+	ChainLink links[SEQ_CHAIN_MAX];
+	uint8_t length;
+	uint8_t link;		// Link playing
+	uint8_t loops;		// Loops started on the link
+	bool enabled;
+	bool dirty;
+} Chain;
+Chain chain;
+
+static void chainRewind();
+static void chainLoop();
+static void chainLoad();
+static void chainSave();
+
+/*****************************************************************************/
+// Realtime recording (overdub)
+typedef struct {
+	uint8_t note;		// Played note (or NOTE_NONE)
+	uint8_t step;		// Quantised step
+	uint32_t time;		// Note on (timebase)
+} Take;
+static Take takes[SEQ_NOTES_MAX];
+
+static void overdubStart();
+static void overdubNoteOn(uint8_t note);
+static void overdubNoteOff(uint8_t note);
+static void overdubCommit(Take * t, uint32_t time);
+
+/*****************************************************************************/
+// Arpeggiator
+/*
+ * Held notes are kept in playing order. The note order
+ * of the selected mode is precomputed in a table each
+ * time the held set changes, so a clock step only
+ * reads the next entry.
+ */
+#define ARP_HELD_MAX	16
+#define ARP_TABLE_MAX	(ARP_HELD_MAX * MSEQ_ARP_OCTAVES_MAX * 2)
+
+typedef struct {
+	uint8_t mode;
+	uint8_t octaves;
+	uint8_t held[ARP_HELD_MAX];		// As played
+	uint8_t count;
+	uint8_t table[ARP_TABLE_MAX];	// Note order
+	uint8_t length;
+	uint8_t index;
+	uint8_t playing;				// Sounding note
+	uint16_t random;
+} Arpeggiator;
+static Arpeggiator arp;
+
+static void arpClear();
+static void arpMute();
+static void arpHold(uint8_t note);
+static void arpRelease(uint8_t note);
+static void arpBuild();
+static void arpClock();
+
+/*****************************************************************************/
+// Pattern import
+/*
+ * Imported patterns are decoded byte by byte in the staging
+ * pattern: root, length, flags, swing, step data size
+ * (16 bits), step data, offsets and gates. Nothing is
+ * changed before the whole pattern is received and checked,
+ * then it replaces its cached copy or takes a spare slot.
+ * The save is queued once the store is idle, so back to back
+ * messages do not wait for flash in the MIDI task (a pattern
+ * arriving before that saves the previous one at once).
+ */
+#define IMPORT_HEADER	6
+
+static Pattern * importSlot;
+static uint8_t importHeader[IMPORT_HEADER];
+static uint16_t importPos;
+static bool importValid;
+static bool importSave;
+
 /*****************************************************************************/
 // Clocks and other states
 static volatile int clocking;
@@ -89,12 +300,18 @@ static uint16_t extClockTicks;
 static bool midiClock;
 static uint16_t midiClockTicks;
 static uint16_t masterClockTicks;
+static uint32_t masterClockTime;
+static uint32_t masterClockPeriod;
 
 static uint16_t clockStamp;
 static uint16_t tapStamps[3];
 static uint16_t tapCount;
 
 static int8_t lastNotes[SEQ_NOTES_MAX];
+static uint16_t lastOffs[SEQ_NOTES_MAX];
+static uint8_t recNotes[SEQ_NOTES_MAX];
+static uint8_t recOffset;
+static uint8_t recGate;
 
 /*****************************************************************************/
 // Sequencer UI
@@ -115,12 +332,18 @@ void mseqInit()
 	seq.dt = 300000UL / (1200 * 2);
 	seq.stamp = uwTick;
 	seq.tick = 0;
+	seq.updated = uwTick - 1;
 
 	seq.pattern = 0;
 	seq.nextPattern = 0;
 	seq.step = 0;
 	seq.halfStep = false;
+	seq.gridRunning = false;
+	seq.donePos = 0;
 	seq.mustClear = false;
+	seq.mustCompile = false;
+	seq.mustPrefetch = false;
+	seq.mustRewind = false;
 	seq.root = NOTE_NONE;
 	
 // Clocking state
@@ -144,15 +367,45 @@ void mseqInit()
 	seqSaveBlink = false;
 
 // Notes and patterns
-	for (int n = 0; n < SEQ_NOTES_MAX; n++)
+	for (int n = 0; n < SEQ_NOTES_MAX; n++) {
 		lastNotes[n] = STEP_EMPTY;
-
-	seqPatternsDefault();
-	seqPatternsLoad();
+		lastOffs[n] = EVENT_END;
+		recNotes[n] = STEP_EMPTY;
+	}
+	recOffset = 0;
+	recGate = SEQ_HALF_RES;
+
+	arp.mode = MSEQ_ARP_OFF;
+	arp.octaves = 1;
+	arp.playing = NOTE_NONE;
+	arp.random = 1;
+	arpClear();
+
+	for (int k = 0; k <= SEQ_CACHE_SLOTS; k++) {
+		Pattern * p = &patternsCache[k];
+		p->id = PATTERN_NONE;
+		p->length = 0;
+		p->size = 0;
+		p->dirty = false;
+	}
+	seqPoolUsed = 0;
+	importValid = false;
+	importSave = false;
+	seqCurrent = seqQueued = seqPatternFetch(0);
+	timeline = &timelines[0];
+	timelineNext = &timelines[1];
+	timeline->top = false;
+	timelineNext->top = true;
+	timelineNext->count = 0;
+	timelineNextPattern = PATTERN_NONE;
+	seqCompile();
+
+	chainLoad();
 }
 
 void mseqUpdate()
 {
+	seq.updated = uwTick;
 	if (extClock || midiClock) {
 		uint16_t dt = uwTick - seq.stamp;
 		if (dt > SEQ_CLOCK_TIMEOUT) {
@@ -187,7 +440,38 @@ void mseqUpdate()
 		if (dt >= SEQ_CLOCK_TIMEOUT) tapCount = 0;
 	}
 
+	if (seq.mustRewind) chainRewind();
+	if (seq.mustCompile) seqCompile();
+	if (seq.mustPrefetch) seqPrefetch();
+	if (importSave && !storePending()) {
+		seqPatternsSave(importSlot);
+		importSave = false;
+	}
 	seqPlay();
+	if ((seq.state == MSEQ_STATE_PLAY ||
+		 seq.state == MSEQ_STATE_OVERDUB) &&
+		seq.gridRunning) seqDispatch(false);
+}
+
+bool mseqPending()
+{
+// New tick, clock or pending change
+	if (seq.updated != uwTick) return true;
+	if (seq.tick != masterClockTicks) return true;
+	if (seq.mustRewind || seq.mustCompile || seq.mustPrefetch)
+		return true;
+
+// Events or gates due on the grid
+	if (!seq.gridRunning) return false;
+	if (seq.state != MSEQ_STATE_PLAY &&
+		seq.state != MSEQ_STATE_OVERDUB)
+		return false;
+	uint32_t elapsed = timeNow() - seq.gridTime;
+	if (seqDue(timeline->next->pos, elapsed)) return true;
+	for (int n = 0; n < SEQ_NOTES_MAX; n++)
+		if (lastOffs[n] != EVENT_END && seqDue(lastOffs[n], elapsed))
+			return true;
+	return false;
 }
 
 /******************************************************************************/
@@ -196,8 +480,12 @@ MSEQ_STATES mseqGetState() {return seq.state;}
 void mseqSetPattern(int pattern)
 {
 	seq.nextPattern = pattern;
-	if (seq.state == MSEQ_STATE_RESET)
+	seqQueued = seqPatternFetch(pattern);
+	if (seq.state == MSEQ_STATE_RESET) {
 		seq.pattern = seq.nextPattern;
+		seqCurrent = seqQueued;
+		seq.mustCompile = true;
+	}else seq.mustPrefetch = true;
 }
 int mseqGetPattern() {return seq.nextPattern;}
 
@@ -221,6 +509,12 @@ void mseqSetClocking(int config)
 
 int mseqGetClocking() {return clocking;}
 
+void mseqSetTempo(int bpm)
+{
+// Internal clock (half-steps)
+	seq.dt = 15000 / bpm;
+}
+
 /******************************************************************************/
 void mseqMIDITick()
 {
@@ -237,6 +531,7 @@ void mseqMIDITick()
 
 	midiClockTicks = 6 - 1;
 	masterClockTicks++;
+	seqClockStamp();
 }
 
 void mseqMIDIStart()
@@ -249,6 +544,16 @@ void mseqMIDIStart()
 	midiClockTicks = 0;
 	masterClockTicks = 0;
 
+// Clock the arpeggiator only
+	if (arp.mode && seq.state == MSEQ_STATE_RESET) {
+		arpMute();
+		seq.halfStep = false;
+		seq.tick = masterClockTicks;
+		seq.stamp = uwTick;
+		arp.index = 0;
+		return;
+	}
+
 	seqHome();
 	seq.state = MSEQ_STATE_PLAY;
 }
@@ -260,6 +565,8 @@ void mseqMIDIContinue()
 	
 	if (extClock) return;
 	midiClock = true;
+	seq.stamp = uwTick;
+	if (arp.mode && seq.state == MSEQ_STATE_RESET) return;
 	seq.state = MSEQ_STATE_PLAY;
 }
 
@@ -270,6 +577,10 @@ void mseqMIDIStop()
 	
 	if (extClock) return;
 	midiClock = false;
+	if (seq.state == MSEQ_STATE_RESET) {
+		arpMute();
+		return;
+	}
 	seq.state = MSEQ_STATE_RESET;
 	seqClean();
 }
@@ -286,6 +597,7 @@ void mseqExtClockTick()
 		extClock = true;
 		extClockTicks = ((int) clocking) >> 2;
 		masterClockTicks = 1;
+		seqClockStamp();
 		return;
 	}
 
@@ -302,6 +614,7 @@ void mseqExtClockTick()
 	seq.plldt = dt >> 1;
 	extClockTicks = ((int) clocking) >> 2;
 	masterClockTicks++;
+	seqClockStamp();
 }
 
 void mseqExtClockStart()
@@ -321,103 +634,250 @@ void seqHome()
 	seq.tick = masterClockTicks;
 	seq.stamp = uwTick;
 	seq.root = NOTE_NONE;
+	seq.gridRunning = false;
+	seq.donePos = 0;
+	seq.mustCompile = true;
+	seq.mustRewind = true;
 }
 
 void seqClean()
 {
+	arpClear();
 	audioAllNotesOff();
-	for (int n = 0; n < SEQ_NOTES_MAX; n++)
+	for (int n = 0; n < SEQ_NOTES_MAX; n++) {
 		lastNotes[n] = -1;
+		lastOffs[n] = EVENT_END;
+	}
 	masterClockTicks = 0;
+	seq.gridRunning = false;
+}
+
+void seqClockStamp()
+{
+// Measure the master clock period
+	uint32_t time = timeNow();
+	if (masterClockTicks > 1)
+		masterClockPeriod = time - masterClockTime;
+	else masterClockPeriod = 0;
+	masterClockTime = time;
 }
 
 void seqPlay()
 {
 // Is it time to play?
+	uint32_t time, period;
 	if (extClock) {
 	// External clock scheme
 		if (seq.tick == masterClockTicks) {
 			if (!seq.halfStep) return;
 			uint16_t dt = uwTick - seq.stamp;
 			if (dt < seq.plldt) return;
-		}else seqTapBlinkFlash();
+			time = timeNow();
+		}else{
+			time = masterClockTime;
+			seqTapBlinkFlash();
+		}
+		period = masterClockPeriod >> 1;
 	}else if (midiClock) {
 	// MIDI clock scheme
 		if (seq.tick == masterClockTicks) 
 			return;
 		if (masterClockTicks & 1)
 			seqTapBlinkFlash();
+		time = masterClockTime;
+		period = masterClockPeriod;
 	}else{
 	// Internal clock scheme
 		uint16_t dt = uwTick - seq.stamp;
 		if (dt < seq.dt) return;
+		time = timeNow();
+		period = (uint32_t) seq.dt * TIME_PER_TICK;
 	}
 
 // Update sequencer state
 	seq.stamp = uwTick;
 	seq.tick = masterClockTicks;
-	if (seq.state != MSEQ_STATE_PLAY)
+	if (seq.state == MSEQ_STATE_RESET) {
+		if (arp.mode) arpClock();
+		return;
+	}
+	if (seq.state != MSEQ_STATE_PLAY &&
+		seq.state != MSEQ_STATE_OVERDUB)
 		return;
 
 // Change current pattern
-	if (seq.pattern != seq.nextPattern) {
-		if (!seq.step && !seq.halfStep) {
-			seq.pattern = seq.nextPattern;
-		}
+	uint8_t half = (seq.step << 1) | seq.halfStep;
+	if (!half) {
+		if (seq.gridRunning) seqDispatch(true);
+		if (seq.pattern != seq.nextPattern) seqSwitch();
+		if (chain.enabled) chainLoop();
+		timeline->next = timeline->events;
+		seq.donePos = 0;
 	}
 
-// Play pattern notes
-	Pattern * p = &patterns[seq.pattern];
-	if (!p->length) return;
-	int nextStep = (seq.step + 1) % p->length;
+// Place the half-step on the timebase
+	seq.gridPos = half * SEQ_HALF_RES;
+	seq.gridTime = time;
+	seq.gridPeriod = period;
+	seq.gridRunning = true;
+
+// Play pattern events
+	Pattern * p = seqCurrent;
+	seqDispatch(false);
 
-	for (int n = 0; n < SEQ_NOTES_MAX; n++) {
-		int note = p->notes[seq.step][n];
-		if (note == STEP_EMPTY) {
-			if (lastNotes[n] > 0)
-				audioNoteOff(lastNotes[n]);
-			lastNotes[n] = -1;
-		}else{
-			if (seq.halfStep) {
-				int next = p->notes[nextStep][n];
-				if (next != STEP_TIE) {
-					if (lastNotes[n] > 0)
-						audioNoteOff(lastNotes[n]);
-					lastNotes[n] = -1;
-				}
-			}else{
-				if (note < STEP_EMPTY) {
-					if (seq.root != NOTE_NONE)
-						note += seq.root - p->root;
-					if (note < 0) note = 0;
-					if (note > 127) note = 127;
-					audioNoteOn(note);
-					lastNotes[n] = note;
-				}
-			}
-		}
-	}
-				
 // Advance the playback
-	if (seq.halfStep) 
-		seq.step = nextStep;
+	if (seq.halfStep) {
+		seq.step++;
+		if (seq.step >= p->length)
+			seq.step = 0;
+	}
 	seq.halfStep = !seq.halfStep;
 	if (seq.halfStep) seqTapBlinkFlash();
 }
 
+void seqDispatch(bool flush)
+{
+	uint8_t notes[SEQ_NOTES_MAX];
+	int count = 0;
+	uint32_t elapsed = timeNow() - seq.gridTime;
+	uint16_t end = seqCurrent->length * SEQ_STEP_RES;
+
+// Release the notes at the end of their gate
+	for (int n = 0; n < SEQ_NOTES_MAX; n++) {
+		uint16_t pos = lastOffs[n];
+		if (pos == EVENT_END) continue;
+		if (flush ? pos >= end : !seqDue(pos, elapsed)) continue;
+		if (lastNotes[n] >= 0)
+			audioNoteOff(lastNotes[n]);
+		lastNotes[n] = -1;
+		lastOffs[n] = EVENT_END;
+	}
+
+// Walk the events due
+	const Event * e = timeline->next;
+	while (e->pos != EVENT_END) {
+		if (!flush && !seqDue(e->pos, elapsed)) break;
+		int n = e->slot;
+		if (lastNotes[n] >= 0)
+			audioNoteOff(lastNotes[n]);
+		lastNotes[n] = e->note;
+		lastOffs[n] = e->pos + e->gate;
+		notes[count++] = e->note;
+		seq.donePos = e->pos + 1;
+		e++;
+	}
+	timeline->next = e;
+
+// Gates crossing the loop end
+	if (flush) {
+		for (int n = 0; n < SEQ_NOTES_MAX; n++)
+			if (lastOffs[n] != EVENT_END) lastOffs[n] -= end;
+	}
+
+// Trigger all the voices at once
+	if (count) audioNotesOn(notes, count);
+}
+
+uint16_t seqPosition(uint32_t time)
+{
+// Current position in the pattern
+	uint32_t elapsed = time - seq.gridTime;
+	uint16_t frac = 0;
+	if (seq.gridPeriod) {
+		if (elapsed >= seq.gridPeriod) frac = SEQ_HALF_RES - 1;
+		else frac = (elapsed * SEQ_HALF_RES) / seq.gridPeriod;
+	}
+	return seq.gridPos + frac;
+}
+
+bool seqDue(uint16_t pos, uint32_t elapsed)
+{
+	if (pos <= seq.gridPos) return true;
+	uint16_t frac = pos - seq.gridPos;
+	if (frac >= SEQ_HALF_RES) return false;
+	return elapsed >= (frac * seq.gridPeriod) / SEQ_HALF_RES;
+}
+
+void seqReleaseSlots()
+{
+	for (int n = 0; n < SEQ_NOTES_MAX; n++) {
+		if (lastNotes[n] >= 0)
+			audioNoteOff(lastNotes[n]);
+		lastNotes[n] = -1;
+		lastOffs[n] = EVENT_END;
+	}
+}
+
+void seqCompile()
+{
+	Pattern * p = seqCurrent;
+	if (seq.step >= p->length) {
+		seq.step = 0;
+		seq.halfStep = false;
+		seq.donePos = 0;
+	}
+	if (!timelinePlace(timeline, timelineCount(p))) {
+	// Drop the prefetched timeline
+		timelineNext->count = 0;
+		timelineNextPattern = PATTERN_NONE;
+		timelinePlace(timeline, timelineCount(p));
+	}
+	timelineCompile(timeline, p, seq.root);
+	timelineSeek(timeline, seq.donePos);
+	seq.mustCompile = false;
+}
+
+void seqPrefetch()
+{
+// Compile the queued pattern ahead
+	seq.mustPrefetch = false;
+	timelineNext->count = 0;
+	timelineNextPattern = PATTERN_NONE;
+	if (seq.nextPattern == seq.pattern) return;
+	seqQueued = seqPatternFetch(seq.nextPattern);
+	if (!timelinePlace(timelineNext, timelineCount(seqQueued))) return;
+	timelineCompile(timelineNext, seqQueued, seq.root);
+	timelineNextPattern = seq.nextPattern;
+}
+
+void seqSwitch()
+{
+	seq.pattern = seq.nextPattern;
+	seqCurrent = seqPatternFetch(seq.pattern);
+	seqReleaseSlots();
+
+// Use the prefetched timeline
+	if (timelineNextPattern == seq.pattern) {
+		Timeline * t = timeline;
+		timeline = timelineNext;
+		timelineNext = t;
+		timelineNext->count = 0;
+		timelineNextPattern = PATTERN_NONE;
+	}else seqCompile();
+}
+
 /*****************************************************************************/
 void mseqNoteOn(uint8_t note)
 {
 	if (seq.state == MSEQ_STATE_RESET) {
 		seqPlayBlinkFlash();
-		audioNoteOn(note);
+		arpHold(note);
+		if (!arp.mode) audioNoteOn(note);
 		seq.root = note;
 	}else if (seq.state == MSEQ_STATE_PLAY) {
 		seqPlayBlinkFlash();
-		seq.root = note;
+		if (seq.root != note) {
+			seq.root = note;
+			seq.mustCompile = true;
+			seq.mustPrefetch = true;
+		}
+	}else if (seq.state == MSEQ_STATE_OVERDUB) {
+		seqRecBlinkFlash();
+		overdubNoteOn(note);
+		audioNoteOn(note);
 	}else if (seq.state == MSEQ_STATE_RECORD) {
 		seqRecBlinkFlash();
-		Pattern * p = &patterns[seq.pattern];
+		Pattern * p = seqCurrent;
 		if (seq.mustClear) {
 			patternClear(p);
 			seq.mustClear = false;
@@ -430,10 +890,14 @@ void mseqNoteOn(uint8_t note)
 void mseqNoteOff(uint8_t note)
 {
 	if (seq.state == MSEQ_STATE_RESET) {
+		arpRelease(note);
+		if (!arp.mode) audioNoteOff(note);
+	}else if (seq.state == MSEQ_STATE_OVERDUB) {
+		overdubNoteOff(note);
 		audioNoteOff(note);
 	}else if (seq.state == MSEQ_STATE_RECORD) {
-		Pattern * p = &patterns[seq.pattern];
-		if (p->notes[p->length][0] == note)
+		Pattern * p = seqCurrent;
+		if (recNotes[0] == note)
 			patternAdvance(p);
 	}
 }
@@ -443,11 +907,12 @@ void mseqPressSave()
 {
 	if (seq.state == MSEQ_STATE_RESET) {
 		if (!seqSaveBlink) {
-			seqPatternsSave(seq.pattern);
+			seqPatternsSave(seqCurrent);
+			if (chain.dirty) chainSave();
 			seqSaveBlinkFlash();
 		}
 	}else if (seq.state == MSEQ_STATE_RECORD) {
-		Pattern * p = &patterns[seq.pattern];
+		Pattern * p = seqCurrent;
 		patternInsert(p, STEP_EMPTY);
 		patternAdvance(p);
 	}
@@ -455,9 +920,11 @@ void mseqPressSave()
 
 void mseqPressTap()
 {
-	if (seq.state == MSEQ_STATE_PLAY) mseqTap();
+	if (seq.state == MSEQ_STATE_PLAY ||
+		seq.state == MSEQ_STATE_OVERDUB ||
+		(seq.state == MSEQ_STATE_RESET && arp.mode)) mseqTap();
 	else if (seq.state == MSEQ_STATE_RECORD) {
-		Pattern * p = &patterns[seq.pattern];
+		Pattern * p = seqCurrent;
 		patternInsert(p, STEP_TIE);
 		patternAdvance(p);
 	}
@@ -465,11 +932,27 @@ void mseqPressTap()
 
 void mseqPressRec()
 {
+// Record over the playing pattern
+	if (seq.state == MSEQ_STATE_PLAY && seqCurrent->length) {
+		overdubStart();
+		seq.state = MSEQ_STATE_OVERDUB;
+		return;
+	}else if (seq.state == MSEQ_STATE_OVERDUB) {
+		uint32_t time = timeNow();
+		for (int n = 0; n < SEQ_NOTES_MAX; n++)
+			overdubCommit(&takes[n], time);
+		seq.state = MSEQ_STATE_PLAY;
+		return;
+	}
+
+// Record step by step
 	seqClean();
 	if (seq.state == MSEQ_STATE_RESET ||
 		seq.state == MSEQ_STATE_PLAY) {
 		seq.step = 0;
 		seq.mustClear = true;
+		recOffset = 0;
+		recGate = SEQ_HALF_RES;
 		seq.state = MSEQ_STATE_RECORD;
 	}else if (seq.state == MSEQ_STATE_RECORD) {
 		seq.step = 0;
@@ -489,6 +972,8 @@ void mseqPressPlay()
 		seq.tick = masterClockTicks;
 		seq.step = 0;
 		seq.halfStep = false;
+		seq.mustCompile = true;
+		seq.mustRewind = true;
 		if (keep) seq.root = NOTE_NONE;
 		if (extClock) extClockTicks = 0;
 		seq.state = MSEQ_STATE_PLAY;
@@ -509,272 +994,689 @@ void mseqTap()
 }
 
 /*****************************************************************************/
-void seqPatternsDefault()
+void mseqSetArp(int mode)
+{
+	if (mode > MSEQ_ARP_PLAYED) mode = MSEQ_ARP_PLAYED;
+	if (arp.mode == mode) return;
+
+// Hand the held keys over
+	arpMute();
+	if (seq.state == MSEQ_STATE_RESET) {
+		for (int n = 0; n < arp.count; n++) {
+			if (!arp.mode) audioNoteOff(arp.held[n]);
+			else if (!mode) audioNoteOn(arp.held[n]);
+		}
+	}
+	arp.mode = mode;
+	arpBuild();
+}
+
+int mseqGetArp() {return arp.mode;}
+
+void mseqSetArpOctaves(int octaves)
+{
+	if (octaves < 1) octaves = 1;
+	if (octaves > MSEQ_ARP_OCTAVES_MAX) octaves = MSEQ_ARP_OCTAVES_MAX;
+	arp.octaves = octaves;
+	arpBuild();
+}
+
+/*****************************************************************************/
+void mseqSetSwing(int swing)
+{
+	Pattern * p = seqCurrent;
+	if (p->swing == swing) return;
+	p->swing = swing;
+	p->dirty = true;
+	seq.mustCompile = true;
+}
+
+int mseqGetSwing() {return seqCurrent->swing;}
+
+void mseqSetOffset(int offset)
+{
+	if (offset > SEQ_HALF_RES) offset = SEQ_HALF_RES;
+	recOffset = offset;
+}
+
+void mseqSetGate(int gate)
+{
+	if (gate < 1) gate = 1;
+	if (gate > 255) gate = 255;
+	recGate = gate;
+}
+
+/*****************************************************************************/
+void mseqSetChain(bool enabled)
+{
+	if (chain.enabled == enabled) return;
+	chain.enabled = enabled;
+	chain.dirty = true;
+	if (seq.state == MSEQ_STATE_RESET)
+		seq.mustRewind = true;
+}
+
+bool mseqGetChain() {return chain.enabled;}
+
+void mseqChainClear()
+{
+	chain.length = 0;
+	chain.link = 0;
+	chain.loops = 0;
+	chain.dirty = true;
+}
+
+void mseqChainAppend(int pattern, int repeats)
+{
+	if (chain.length >= SEQ_CHAIN_MAX) return;
+	if (repeats <= 0) return;
+	ChainLink * l = &chain.links[chain.length++];
+	l->pattern = pattern;
+	l->repeats = repeats;
+	chain.dirty = true;
+}
+
+/*****************************************************************************/
+void chainRewind()
+{
+	seq.mustRewind = false;
+	chain.link = 0;
+	chain.loops = 0;
+	if (!chain.enabled || !chain.length) return;
+
+// Start on the first link
+	mseqSetPattern(chain.links[0].pattern);
+	seq.pattern = seq.nextPattern;
+	seqCurrent = seqPatternFetch(seq.pattern);
+	seq.mustCompile = true;
+	seq.mustPrefetch = false;
+}
+
+void chainLoop()
+{
+	if (!chain.length) return;
+
+// Move to the next link
+	int next = chain.link + 1;
+	if (next >= chain.length) next = 0;
+	if (chain.loops >= chain.links[chain.link].repeats) {
+		chain.link = next;
+		chain.loops = 0;
+		if (++next >= chain.length) next = 0;
+	}
+
+// Queue the next pattern one loop ahead
+	chain.loops++;
+	if (chain.loops < chain.links[chain.link].repeats) return;
+	seq.nextPattern = chain.links[next].pattern;
+	seq.mustPrefetch = true;
+}
+
+/*****************************************************************************/
+void chainLoad()
+{
+// Load and sanitize the chain
+	uint32_t header;
+	uint8_t * bytes = (uint8_t *) &header;
+	storeRead32(CHAIN_ADDR, &header);
+	chain.length = 0;
+	chain.enabled = false;
+	if (bytes[0] > SEQ_CHAIN_MAX) return;
+	chain.enabled = bytes[1] == 1;
+
+	uint32_t addr = CHAIN_ADDR + 4;
+	for (int k = 0; k < bytes[0]; k++) {
+		uint32_t dword;
+		uint8_t * link = (uint8_t *) &dword;
+		storeRead32(addr, &dword);
+		if (link[0] >= SEQ_PATTERNS_MAX || !link[1]) break;
+		mseqChainAppend(link[0], link[1]);
+		addr += 4;
+	}
+	chain.dirty = false;
+}
+
+void chainSave()
+{
+	uint32_t header = 0xFFFF0000;
+	uint8_t * bytes = (uint8_t *) &header;
+	bytes[0] = chain.length;
+	bytes[1] = chain.enabled ? 1 : 0;
+
+// Update the chain
+	storeErasePage(CHAIN_ADDR);
+	storeWrite32(CHAIN_ADDR, &header);
+	uint32_t addr = CHAIN_ADDR + 4;
+	for (int k = 0; k < chain.length; k++) {
+		uint32_t dword = 0xFFFF0000;
+		uint8_t * link = (uint8_t *) &dword;
+		link[0] = chain.links[k].pattern;
+		link[1] = chain.links[k].repeats;
+		storeWrite32(addr, &dword);
+		addr += 4;
+	}
+	chain.dirty = false;
+}
+
+/*****************************************************************************/
+void overdubStart()
+{
+	for (int n = 0; n < SEQ_NOTES_MAX; n++)
+		takes[n].note = NOTE_NONE;
+}
+
+void overdubNoteOn(uint8_t note)
+{
+	if (!seq.gridRunning) return;
+
+// Quantise to the nearest step
+	Pattern * p = seqCurrent;
+	uint16_t pos = seqPosition(timeNow()) + SEQ_HALF_RES;
+	int step = pos / SEQ_STEP_RES;
+	if (step >= p->length) step = 0;
+
+// Hold it until the note off
+	for (int n = 0; n < SEQ_NOTES_MAX; n++) {
+		Take * t = &takes[n];
+		if (t->note != NOTE_NONE) continue;
+		t->note = note;
+		t->step = step;
+		t->time = timeNow();
+		return;
+	}
+}
+
+void overdubNoteOff(uint8_t note)
+{
+	for (int n = 0; n < SEQ_NOTES_MAX; n++) {
+		Take * t = &takes[n];
+		if (t->note != note) continue;
+		overdubCommit(t, timeNow());
+		return;
+	}
+}
+
+void overdubCommit(Take * t, uint32_t time)
+{
+	if (t->note == NOTE_NONE) return;
+	Pattern * p = seqCurrent;
+
+// Undo the transposition
+	int note = t->note;
+	if (seq.root != NOTE_NONE)
+		note -= seq.root - p->root;
+	if (note < 0) note = 0;
+	if (note > 127) note = 127;
+	t->note = NOTE_NONE;
+
+// Length in steps (rounded)
+	int ties = 0;
+	uint32_t period = seq.gridPeriod << 1;
+	if (period) ties = (time - t->time + (period >> 1)) / period;
+	if (ties) ties--;
+	if (ties >= p->length) ties = p->length - 1;
+
+// Merge into a free slot of the step
+	uint8_t notes[SEQ_NOTES_MAX];
+	patternDecode(&patternData(p)[patternFind(p, t->step)], notes);
+	int slot = 0;
+	while (slot < SEQ_NOTES_MAX && notes[slot] != STEP_EMPTY) slot++;
+	if (slot >= SEQ_NOTES_MAX) return;
+	if (!patternSetSlot(p, t->step, slot, note)) return;
+
+// Hold over the next steps
+	int step = t->step;
+	for (int k = 0; k < ties; k++) {
+		if (++step >= p->length) step = 0;
+		patternDecode(&patternData(p)[patternFind(p, step)], notes);
+		if (notes[slot] != STEP_EMPTY) break;
+		if (!patternSetSlot(p, step, slot, STEP_TIE)) break;
+	}
+	seq.mustCompile = true;
+}
+
+/*****************************************************************************/
+void arpClear()
+{
+	arpMute();
+	arp.count = 0;
+	arp.length = 0;
+	arp.index = 0;
+}
+
+void arpMute()
+{
+	if (arp.playing != NOTE_NONE)
+		audioNoteOff(arp.playing);
+	arp.playing = NOTE_NONE;
+}
+
+void arpHold(uint8_t note)
+{
+	for (int n = 0; n < arp.count; n++)
+		if (arp.held[n] == note) return;
+	if (arp.count >= ARP_HELD_MAX) return;
+	arp.held[arp.count++] = note;
+	arpBuild();
+}
+
+void arpRelease(uint8_t note)
+{
+	int n = 0;
+	while (n < arp.count && arp.held[n] != note) n++;
+	if (n >= arp.count) return;
+	arp.count--;
+	for (; n < arp.count; n++)
+		arp.held[n] = arp.held[n + 1];
+	if (!arp.count) arpClear();
+	else arpBuild();
+}
+
+void arpBuild()
+{
+// Sort the held notes
+	uint8_t notes[ARP_HELD_MAX];
+	int count = arp.count;
+	for (int n = 0; n < count; n++) {
+		uint8_t note = arp.held[n];
+		int k = n;
+		if (arp.mode != MSEQ_ARP_PLAYED) {
+			for (; k > 0 && notes[k - 1] > note; k--)
+				notes[k] = notes[k - 1];
+		}
+		notes[k] = note;
+	}
+
+// Spread over the octaves
+	int length = 0;
+	for (int o = 0; o < arp.octaves; o++) {
+		for (int n = 0; n < count; n++) {
+			int note = notes[n] + 12 * o;
+			if (note > 127) break;
+			arp.table[length++] = note;
+		}
+	}
+
+// Arrange for the mode
+	if (arp.mode == MSEQ_ARP_DOWN) {
+		for (int i = 0, j = length - 1; i < j; i++, j--) {
+			uint8_t note = arp.table[i];
+			arp.table[i] = arp.table[j];
+			arp.table[j] = note;
+		}
+	}else if (arp.mode == MSEQ_ARP_UPDOWN) {
+		for (int i = length - 2; i > 0; i--)
+			arp.table[length++] = arp.table[i];
+	}
+	arp.length = length;
+	if (arp.index >= length) arp.index = 0;
+}
+
+void arpClock()
+{
+// Release the previous note
+	if (arp.playing != NOTE_NONE) {
+		audioNoteOff(arp.playing);
+		arp.playing = NOTE_NONE;
+	}
+
+// Play a note every step
+	bool start = !seq.halfStep;
+	seq.halfStep = !seq.halfStep;
+	if (!start || !arp.length) return;
+	seqTapBlinkFlash();
+
+	int index = arp.index;
+	if (arp.mode == MSEQ_ARP_RANDOM) {
+		arp.random = arp.random * 25173 + 13849;
+		index = (arp.random >> 8) % arp.length;
+	}else if (++arp.index >= arp.length)
+		arp.index = 0;
+	arp.playing = arp.table[index];
+	audioNoteOn(arp.playing);
+}
+
+/*****************************************************************************/
+void mseqImportBegin(int pattern)
 {
-// Clear everything
-	for (int k = 0; k < SEQ_PATTERNS_MAX; k++) {
-		Pattern * p = &patterns[k];
-		patternClear(p);
-		p->id = k;
+	Pattern * p = importPattern;
+	if (importSave) {
+		seqPatternsSave(importSlot);
+		importSave = false;
 	}
+	patternFree(p);
+	p->id = pattern;
+	importPos = 0;
+	importValid = pattern < SEQ_PATTERNS_MAX;
+}
+
+void mseqImportByte(uint8_t b)
+{
+	Pattern * p = importPattern;
+	if (!importValid) return;
+
+// Pattern header
+	uint16_t pos = importPos++;
+	if (pos < IMPORT_HEADER) {
+		importHeader[pos] = b;
+		if (pos < IMPORT_HEADER - 1) return;
+		uint8_t length = importHeader[1];
+		uint16_t size = importHeader[4] | (uint16_t) importHeader[5] << 8;
+		if (length == 0 ||
+			length >= SEQ_STEPS_MAX ||
+			size > PATTERN_DATA_MAX) {
+			importValid = false;
+			return;
+		}
 
+	// Room for the steps
+		p->root = importHeader[0];
+		p->length = length;
+		p->flags = importHeader[2] & ~(PATTERN_COMPACT | PATTERN_TIMING | PATTERN_GATES);
+		p->swing = importHeader[3];
+		p->size = size;
+		importValid = patternAlloc(p);
+		return;
+	}
+
+// Step data, offsets and gates
+	pos -= IMPORT_HEADER;
+	if (pos < p->size) {
+		patternData(p)[pos] = b;
+		return;
+	}
+	pos -= p->size;
+	if (pos < p->length) {
+		patternOffsets(p)[pos] = b;
+		return;
+	}
+	pos -= p->length;
+	if (pos < p->length) {
+		patternGates(p)[pos] = b;
+		return;
+	}
+	importValid = false;
+}
+
+bool mseqImportEnd(bool commit)
+{
+	Pattern * p = importPattern;
+	bool valid = commit && importValid &&
+		importPos == IMPORT_HEADER + p->size + 2 * p->length;
+	importValid = false;
+
+// Check the step data
+	const uint8_t * src = patternData(p);
+	uint8_t notes[SEQ_NOTES_MAX];
+	if (valid) {
+		for (int s = 0; s < p->length; s++)
+			src = patternDecode(src, notes);
+		valid = src == patternData(p) + p->size;
+	}
+	if (!valid) {
+		patternFree(p);
+		return false;
+	}
+
+// Replace the cached copy or take a spare slot
+	Pattern * c = 0;
+	for (int k = 0; k < SEQ_CACHE_SLOTS; k++)
+		if (patternsCache[k].id == p->id) c = &patternsCache[k];
+	if (!c) c = seqPatternSpare();
+	patternFree(c);
+	*c = *p;
+	c->dirty = true;
+	p->length = 0;
+	p->size = 0;
+	if (c == seqCurrent) seq.mustCompile = true;
+	else if (c->id == seq.nextPattern) seq.mustPrefetch = true;
+
+// Save when the store is idle
+	importSlot = c;
+	importSave = true;
+	seqSaveBlinkFlash();
+	return true;
+}
+
+/*****************************************************************************/
+#define __	STEP_EMPTY
+#define TT	STEP_TIE
+#define B	NOTE_BASE
+
+typedef struct {
+	uint8_t length;
+	uint8_t notes[8][3];
+} PatternDefault;
+
+static const PatternDefault patternsDefault[] = {
 // MONO	PATTERNS
-// Pattern 1
-	Pattern * p1 = &patterns[0];
-	p1->root = NOTE_BASE;
-	p1->length = 4;
-	p1->notes[0][0] = NOTE_BASE;
-	p1->notes[1][0] = NOTE_BASE;
-	p1->notes[2][0] = NOTE_BASE;
-	p1->notes[3][0] = NOTE_BASE;
-
-// Pattern 2
-	Pattern * p2 = &patterns[1];
-	p2->root = NOTE_BASE;
-	p2->length = 4;
-	p2->notes[0][0] = NOTE_BASE;
-	p2->notes[1][0] = NOTE_BASE + 12;
-	p2->notes[2][0] = NOTE_BASE;
-	p2->notes[3][0] = NOTE_BASE + 12;
-
-// Pattern 3
-	Pattern * p3 = &patterns[2];
-	p3->root = NOTE_BASE;
-	p3->length = 4;
-	p3->notes[0][0] = NOTE_BASE;
-	p3->notes[1][0] = NOTE_BASE + 12;
-	p3->notes[2][0] = NOTE_BASE + 7;
-	p3->notes[3][0] = NOTE_BASE + 12;
-
-// Pattern 4
-	Pattern * p4 = &patterns[3];
-	p4->root = NOTE_BASE;
-	p4->length = 4;
-	p4->notes[0][0] = NOTE_BASE;
-	p4->notes[1][0] = NOTE_BASE + 10;
-	p4->notes[2][0] = NOTE_BASE + 12;
-	p4->notes[3][0] = NOTE_BASE + 3;
-
-// Pattern 5
-	Pattern * p5 = &patterns[4];
-	p5->root = NOTE_BASE;
-	p5->length = 8;
-	p5->notes[0][0] = NOTE_BASE;
-	p5->notes[1][0] = STEP_EMPTY;
-	p5->notes[2][0] = NOTE_BASE;
-	p5->notes[3][0] = NOTE_BASE;
-	p5->notes[4][0] = STEP_EMPTY;
-	p5->notes[5][0] = NOTE_BASE;
-	p5->notes[6][0] = NOTE_BASE;
-	p5->notes[7][0] = STEP_EMPTY;
-
-// Pattern 6
-	Pattern * p6 = &patterns[5];
-	p6->root = NOTE_BASE;
-	p6->length = 8;
-	p6->notes[0][0] = NOTE_BASE;
-	p6->notes[1][0] = NOTE_BASE;
-	p6->notes[2][0] = STEP_EMPTY;
-	p6->notes[3][0] = NOTE_BASE;
-	p6->notes[4][0] = STEP_EMPTY;
-	p6->notes[5][0] = NOTE_BASE;
-	p6->notes[6][0] = STEP_TIE;
-	p6->notes[7][0] = STEP_EMPTY;
-
-// Pattern 7
-	Pattern * p7 = &patterns[6];
-	p7->root = NOTE_BASE;
-	p7->length = 8;
-	p7->notes[0][0] = NOTE_BASE;
-	p7->notes[1][0] = STEP_TIE;
-	p7->notes[2][0] = NOTE_BASE + 7;
-	p7->notes[3][0] = NOTE_BASE;
-	p7->notes[4][0] = STEP_EMPTY;
-	p7->notes[5][0] = NOTE_BASE + 12;
-	p7->notes[6][0] = STEP_EMPTY;
-	p7->notes[7][0] = NOTE_BASE + 12;
-
-// Pattern 8
-	Pattern * p8 = &patterns[7];
-	p8->root = NOTE_BASE;
-	p8->length = 8;
-	p8->notes[0][0] = NOTE_BASE;
-	p8->notes[1][0] = NOTE_BASE - 5;
-	p8->notes[2][0] = NOTE_BASE + 7;
-	p8->notes[3][0] = NOTE_BASE;
-	p8->notes[4][0] = STEP_TIE;
-	p8->notes[5][0] = STEP_EMPTY;
-	p8->notes[6][0] = NOTE_BASE + 12;
-	p8->notes[7][0] = STEP_EMPTY;
+	{4, {{B,__,__}, {B,__,__}, {B,__,__}, {B,__,__}}},
+	{4, {{B,__,__}, {B+12,__,__}, {B,__,__}, {B+12,__,__}}},
+	{4, {{B,__,__}, {B+12,__,__}, {B+7,__,__}, {B+12,__,__}}},
+	{4, {{B,__,__}, {B+10,__,__}, {B+12,__,__}, {B+3,__,__}}},
+	{8, {{B,__,__}, {__,__,__}, {B,__,__}, {B,__,__},
+		 {__,__,__}, {B,__,__}, {B,__,__}, {__,__,__}}},
+	{8, {{B,__,__}, {B,__,__}, {__,__,__}, {B,__,__},
+		 {__,__,__}, {B,__,__}, {TT,__,__}, {__,__,__}}},
+	{8, {{B,__,__}, {TT,__,__}, {B+7,__,__}, {B,__,__},
+		 {__,__,__}, {B+12,__,__}, {__,__,__}, {B+12,__,__}}},
+	{8, {{B,__,__}, {B-5,__,__}, {B+7,__,__}, {B,__,__},
+		 {TT,__,__}, {__,__,__}, {B+12,__,__}, {__,__,__}}},
 
 // POLY	PATTERNS
-// Pattern 9
-	Pattern * p9 = &patterns[8];
-	p9->root = NOTE_BASE;
-	p9->length = 4;
-	p9->notes[0][0] = NOTE_BASE;
-	p9->notes[1][0] = NOTE_BASE;
-	p9->notes[1][1] = NOTE_BASE + 7;
-	p9->notes[1][2] = NOTE_BASE + 15;
-	p9->notes[2][0] = NOTE_BASE;
-	p9->notes[3][0] = NOTE_BASE;
-	p9->notes[3][1] = NOTE_BASE + 7;
-	p9->notes[3][2] = NOTE_BASE + 15;
-
-// Pattern 10
-	Pattern * p10 = &patterns[9];
-	p10->root = NOTE_BASE;
-	p10->length = 4;
-	p10->notes[0][0] = NOTE_BASE;
-	p10->notes[1][0] = NOTE_BASE;
-	p10->notes[1][1] = NOTE_BASE + 7;
-	p10->notes[1][2] = NOTE_BASE + 16;
-	p10->notes[2][0] = NOTE_BASE;
-	p10->notes[3][0] = NOTE_BASE;
-	p10->notes[3][1] = NOTE_BASE + 7;
-	p10->notes[3][2] = NOTE_BASE + 16;
-
-// Pattern 11
-	Pattern * p11 = &patterns[10];
-	p11->root = NOTE_BASE;
-	p11->length = 4;
-	p11->notes[0][0] = NOTE_BASE;
-	p11->notes[1][0] = NOTE_BASE + 12;
-	p11->notes[2][0] = NOTE_BASE;
-	p11->notes[2][1] = NOTE_BASE + 7;
-	p11->notes[3][0] = NOTE_BASE + 12;
-
-// Pattern 12
-	Pattern * p12 = &patterns[11];
-	p12->root = NOTE_BASE;
-	p12->length = 4;
-	p12->notes[0][0] = NOTE_BASE;
-	p12->notes[1][0] = NOTE_BASE + 12;
-	p12->notes[2][0] = NOTE_BASE;
-	p12->notes[2][1] = NOTE_BASE + 10;
-	p12->notes[3][0] = NOTE_BASE + 12;
-
-// Pattern 13
-	Pattern * p13 = &patterns[12];
-	p13->root = NOTE_BASE;
-	p13->length = 8;
-	p13->notes[0][0] = NOTE_BASE;
-	p13->notes[0][1] = NOTE_BASE + 12;
-	p13->notes[1][0] = NOTE_BASE;
-	p13->notes[2][0] = STEP_EMPTY;
-	p13->notes[3][0] = STEP_EMPTY;
-	p13->notes[4][0] = NOTE_BASE;
-	p13->notes[4][1] = NOTE_BASE + 5;
-	p13->notes[5][0] = NOTE_BASE;
-	p13->notes[5][1] = NOTE_BASE + 12;
-	p13->notes[6][0] = STEP_EMPTY;
-	p13->notes[7][0] = STEP_EMPTY;
-
-// Pattern 14
-	Pattern * p14 = &patterns[13];
-	p14->root = NOTE_BASE;
-	p14->length = 8;
-	p14->notes[0][0] = NOTE_BASE;
-	p14->notes[0][1] = NOTE_BASE + 12;
-	p14->notes[1][0] = STEP_EMPTY;
-	p14->notes[2][0] = NOTE_BASE;
-	p14->notes[3][0] = STEP_EMPTY;
-	p14->notes[4][0] = NOTE_BASE;
-	p14->notes[4][1] = NOTE_BASE + 7;
-	p14->notes[5][0] = NOTE_BASE;
-	p14->notes[5][1] = NOTE_BASE + 12;
-	p14->notes[6][0] = STEP_EMPTY;
-	p14->notes[7][0] = NOTE_BASE;
-
-// Pattern 15
-	Pattern * p15 = &patterns[14];
-	p15->root = NOTE_BASE;
-	p15->length = 8;
-	p15->notes[0][0] = NOTE_BASE;
-	p15->notes[0][1] = NOTE_BASE + 7;
-	p15->notes[1][0] = STEP_TIE;
-	p15->notes[1][1] = STEP_TIE;
-	p15->notes[2][0] = NOTE_BASE + 12;
-	p15->notes[3][0] = STEP_EMPTY;
-	p15->notes[4][0] = NOTE_BASE + 5;
-	p15->notes[5][0] = STEP_EMPTY;
-	p15->notes[6][0] = NOTE_BASE + 5;
-	p15->notes[7][0] = NOTE_BASE + 1;
-	p15->notes[7][1] = NOTE_BASE + 5;
-
-// Pattern 16
-	Pattern * p16 = &patterns[15];
-	p16->root = NOTE_BASE;
-	p16->length = 8;
-	p16->notes[0][0] = NOTE_BASE;
-	p16->notes[1][0] = NOTE_BASE + 7;
-	p16->notes[1][1] = NOTE_BASE + 12;
-	p16->notes[2][0] = NOTE_BASE;
-	p16->notes[3][0] = STEP_EMPTY;
-	p16->notes[4][0] = NOTE_BASE;
-	p16->notes[5][0] = NOTE_BASE + 10;
-	p16->notes[5][1] = NOTE_BASE + 12;
-	p16->notes[6][0] = STEP_TIE;
-	p16->notes[6][1] = STEP_TIE;
-	p16->notes[7][0] = NOTE_BASE + 5;
+	{4, {{B,__,__}, {B,B+7,B+15}, {B,__,__}, {B,B+7,B+15}}},
+	{4, {{B,__,__}, {B,B+7,B+16}, {B,__,__}, {B,B+7,B+16}}},
+	{4, {{B,__,__}, {B+12,__,__}, {B,B+7,__}, {B+12,__,__}}},
+	{4, {{B,__,__}, {B+12,__,__}, {B,B+10,__}, {B+12,__,__}}},
+	{8, {{B,B+12,__}, {B,__,__}, {__,__,__}, {__,__,__},
+		 {B,B+5,__}, {B,B+12,__}, {__,__,__}, {__,__,__}}},
+	{8, {{B,B+12,__}, {__,__,__}, {B,__,__}, {__,__,__},
+		 {B,B+7,__}, {B,B+12,__}, {__,__,__}, {B,__,__}}},
+	{8, {{B,B+7,__}, {TT,TT,__}, {B+12,__,__}, {__,__,__},
+		 {B+5,__,__}, {__,__,__}, {B+5,__,__}, {B+1,B+5,__}}},
+	{8, {{B,__,__}, {B+7,B+12,__}, {B,__,__}, {__,__,__},
+		 {B,__,__}, {B+10,B+12,__}, {TT,TT,__}, {B+5,__,__}}},
+};
+
+#undef __
+#undef TT
+#undef B
+
+void patternDefault(Pattern * p)
+{
+// Start empty
+	patternFree(p);
+	p->root = NOTE_BASE;
+	p->flags = 0;
+	p->swing = 0;
+
+// Factory patterns
+	int count = sizeof(patternsDefault) / sizeof(PatternDefault);
+	if (p->id >= count) return;
+	const PatternDefault * d = &patternsDefault[p->id];
+	for (int s = 0; s < d->length; s++) {
+		uint8_t notes[SEQ_NOTES_MAX];
+		for (int n = 0; n < SEQ_NOTES_MAX; n++)
+			notes[n] = n < 3 ? d->notes[s][n] : STEP_EMPTY;
+		patternAppend(p, notes);
+	}
 }
 
 /*****************************************************************************/
-void seqPatternsLoad()
+Pattern * seqPatternFetch(int id)
 {
-// Browse all patterns records
-	uint32_t addr = PATTERNS_ADDR;
-	for (int s = 0; s < STORE_PATTERNS_PER_PAGE * SEQ_PATTERNS_MAX; s++) {
-	// Load a pattern header
-		uint32_t header;
-		uint8_t * bytes = (uint8_t *) &header;
-		storeRead32(addr, &header);
-		if (header == 0xFFFFFFFF ||
-			header == 0x00000000) {
-			addr += STORE_PATTERN_SIZE;
-			continue;
-		}
+// Already in the cache
+	for (int k = 0; k < SEQ_CACHE_SLOTS; k++) {
+		Pattern * p = &patternsCache[k];
+		if (p->id == id) return p;
+	}
 
-	// Check pattern content
-		uint8_t len = bytes[1];
-		uint8_t id	= bytes[2];
-		if (len > 0 &&
-			len < SEQ_STEPS_MAX &&
-			id < SEQ_PATTERNS_MAX)
-			patternLoad(addr, &patterns[id]);
-		addr += STORE_PATTERN_SIZE;
+// Refill a spare slot from flash
+	Pattern * p = seqPatternSpare();
+	p->id = id;
+	seqPatternsLoad(p);
+	return p;
+}
+
+Pattern * seqPatternSpare()
+{
+// Pick a slot, keep unsaved recordings if possible
+	Pattern * p = 0;
+	for (int k = 0; k < SEQ_CACHE_SLOTS; k++) {
+		Pattern * c = &patternsCache[k];
+		if (c == seqCurrent || c == seqQueued) continue;
+		if (!p || (p->dirty && !c->dirty)) p = c;
 	}
+	seqPatternEvict(p);
+	return p;
 }
 
-void seqPatternsSave(int id)
+void seqPatternEvict(Pattern * p)
 {
+// Save the recording first
+	if (p->dirty) {
+		seqPatternsSave(p);
+		seqSaveBlinkFlash();
+	}
+	if (importSlot == p) importSave = false;
+	if (seqQueued == p) seqQueued = seqCurrent;
+	patternFree(p);
+	p->id = PATTERN_NONE;
+}
+
+void seqPatternsLoad(Pattern * p)
+{
+// Factory content
+	patternDefault(p);
+
+// Browse the pattern records (last one wins)
+	uint32_t addr = STORE_PATTERNS_ADDR(p->id);
+	uint32_t end = addr + FLASH_PAGE_SIZE;
+	while (addr < end) {
+		uint32_t next = patternNext(addr);
+		if (!next) break;
+		patternLoad(addr, p);
+		addr = next;
+	}
+	p->dirty = false;
+}
+
+void seqPatternsSave(Pattern * p)
+{
+// Find the end of the records
+	uint32_t addr = STORE_PATTERNS_ADDR(p->id);
+	uint32_t end = addr + FLASH_PAGE_SIZE;
+	while (addr < end) {
+		uint32_t next = patternNext(addr);
+		if (!next) break;
+		addr = next;
+	}
+
 // Save on a free record
-	uint32_t addr = STORE_PATTERNS_ADDR(id);
-	for (int s = 0; s < STORE_PATTERNS_PER_PAGE; s++) {
+	p->dirty = false;
+	uint32_t size = patternRecord(p->size, p->length, patternFlags(p));
+	if (addr + size <= end) {
 		uint32_t header;
 		storeRead32(addr, &header);
 		if (header == 0xFFFFFFFF) {
-			patternSave(addr, &patterns[id]);
+			patternSave(addr, p);
 			return;
 		}
-		addr += STORE_PATTERN_SIZE;
 	}
 
 // Clear the whole page and save
-	addr = STORE_PATTERNS_ADDR(id);
+	addr = STORE_PATTERNS_ADDR(p->id);
 	storeErasePage(addr);
-	patternSave(addr, &patterns[id]);
+	patternSave(addr, p);
 }
 
 /*****************************************************************************/
+bool poolReserve(Pattern * p, uint16_t bytes)
+{
+// Empty blocks start at the end of the pool
+	if (!p->length && !p->size) p->base = seqPoolUsed;
+
+// Evict the spare slots, then the queued pattern
+	for (int pass = 0; pass < 3; pass++) {
+		for (int k = 0; k < SEQ_CACHE_SLOTS; k++) {
+			if (seqPoolUsed + bytes <= SEQ_POOL_SIZE) return true;
+			Pattern * c = &patternsCache[k];
+			if (c == p || c == seqCurrent || c->id == PATTERN_NONE) continue;
+			if (pass == 0 && (c->dirty || c == seqQueued)) continue;
+			if (pass == 1 && c == seqQueued) continue;
+			seqPatternEvict(c);
+		}
+	}
+
+// Drop the import in progress
+	if (seqPoolUsed + bytes > SEQ_POOL_SIZE && p != importPattern) {
+		importValid = false;
+		patternFree(importPattern);
+	}
+	return seqPoolUsed + bytes <= SEQ_POOL_SIZE;
+}
+
+void poolResize(Pattern * p, uint16_t at, int delta)
+{
+	uint16_t pos = p->base + at;
+
+	if (delta > 0) {
+		for (uint16_t i = seqPoolUsed; i > pos; i--)
+			seqPool[i - 1 + delta] = seqPool[i - 1];
+	}else{
+		pos -= delta;
+		for (uint16_t i = pos; i < seqPoolUsed; i++)
+			seqPool[i + delta] = seqPool[i];
+	}
+	seqPoolUsed += delta;
+
+// Move the blocks above
+	for (int k = 0; k <= SEQ_CACHE_SLOTS; k++) {
+		Pattern * c = &patternsCache[k];
+		if (c != p && c->base >= pos) c->base += delta;
+	}
+}
+
+uint8_t * patternOffsets(const Pattern * p) {return &seqPool[p->base];}
+uint8_t * patternGates(const Pattern * p) {return &seqPool[p->base + p->length];}
+uint8_t * patternData(const Pattern * p) {return &seqPool[p->base + 2 * p->length];}
+
+bool patternAlloc(Pattern * p)
+{
+// Block for the current length and size
+	uint16_t bytes = 2 * p->length + p->size;
+	uint8_t length = p->length;
+	uint16_t size = p->size;
+	p->length = 0;
+	p->size = 0;
+	if (!poolReserve(p, bytes)) return false;
+	poolResize(p, 0, bytes);
+	p->length = length;
+	p->size = size;
+	return true;
+}
+
+void patternFree(Pattern * p)
+{
+	poolResize(p, 0, -(2 * p->length + p->size));
+	p->length = 0;
+	p->size = 0;
+}
+
 void patternClear(Pattern * p)
 {
+// Imported pattern not saved yet
+	if (importSave && importSlot == p) {
+		seqPatternsSave(p);
+		importSave = false;
+	}
+	patternFree(p);
 	p->root = NOTE_BASE;
-	p->length = 0;
 	p->flags = 0;
-	for (int s = 0; s < SEQ_STEPS_MAX; s++)
+	p->swing = 0;
+	p->dirty = true;
 	for (int n = 0; n < SEQ_NOTES_MAX; n++)
-		p->notes[s][n] = STEP_EMPTY;
+		recNotes[n] = STEP_EMPTY;
 }
 
 void patternInsert(Pattern * p, uint8_t note)
@@ -782,10 +1684,9 @@ void patternInsert(Pattern * p, uint8_t note)
 // Insert one note
 	if (note < STEP_EMPTY) {
 		if (!p->length)	p->root = note;
-		uint8_t * notes = p->notes[p->length];
 		for (int n = 0; n < SEQ_NOTES_MAX; n++) {
-			if (notes[n] != STEP_EMPTY) continue;
-			notes[n] = note;
+			if (recNotes[n] != STEP_EMPTY) continue;
+			recNotes[n] = note;
 			break;
 		}
 		return;
@@ -793,40 +1694,399 @@ void patternInsert(Pattern * p, uint8_t note)
 
 // Insert an event
 	if (!p->length)	p->root = NOTE_BASE;
-	uint8_t * notes = p->notes[p->length];
 	for (int n = 0; n < SEQ_NOTES_MAX; n++)
-		notes[n] = note;
+		recNotes[n] = note;
 }
 
 void patternAdvance(Pattern * p)
 {
 	seqClean();
-	if (p->length < SEQ_STEPS_MAX-1)
-		p->length++;
-	else{
+	if (p->length < SEQ_STEPS_MAX-1 &&
+		patternAppend(p, recNotes)) {
+		patternOffsets(p)[p->length - 1] = recOffset;
+		patternGates(p)[p->length - 1] = recGate;
+		for (int n = 0; n < SEQ_NOTES_MAX; n++)
+			recNotes[n] = STEP_EMPTY;
+		recOffset = 0;
+		recGate = SEQ_HALF_RES;
+	}else{
 		seq.step = 0;
 		seq.halfStep = false;
+		seq.mustCompile = true;
 		seq.state = MSEQ_STATE_PLAY;
 	}
 }
+
+bool patternAppend(Pattern * p, const uint8_t * notes)
+{
+	uint8_t step[1 + SEQ_NOTES_MAX];
+	int len = patternEncode(notes, step);
+	if (p->size + len > PATTERN_DATA_MAX)
+		return false;
+	if (!poolReserve(p, 2 + len))
+		return false;
+
+// Grow the offsets, gates and data
+	uint8_t length = p->length;
+	poolResize(p, length, 1);
+	poolResize(p, 2 * length + 1, 1);
+	poolResize(p, 2 * length + 2 + p->size, len);
+	p->length++;
+
+	uint8_t * dst = &patternData(p)[p->size];
+	for (int i = 0; i < len; i++)
+		dst[i] = step[i];
+	patternOffsets(p)[length] = 0;
+	patternGates(p)[length] = SEQ_HALF_RES;
+	p->size += len;
+	p->dirty = true;
+	return true;
+}
+
+/*****************************************************************************/
+const uint8_t * patternDecode(const uint8_t * src, uint8_t * notes)
+{
+	uint8_t mask = *src++;
+	for (int n = 0; n < SEQ_NOTES_MAX; n++) {
+		int code = mask & SLOT_BITS;
+		if (code == SLOT_NOTE) notes[n] = *src++;
+		else if (code == SLOT_TIE) notes[n] = STEP_TIE;
+		else notes[n] = STEP_EMPTY;
+		mask >>= 2;
+	}
+	return src;
+}
+
+int patternEncode(const uint8_t * notes, uint8_t * dst)
+{
+	uint8_t mask = 0;
+	int len = 1;
+	for (int n = 0; n < SEQ_NOTES_MAX; n++) {
+		int code = SLOT_EMPTY;
+		if (notes[n] == STEP_TIE) code = SLOT_TIE;
+		else if (notes[n] < STEP_EMPTY) {
+			code = SLOT_NOTE;
+			dst[len++] = notes[n];
+		}
+		mask |= code << (n << 1);
+	}
+	dst[0] = mask;
+	return len;
+}
+
+int patternDelay(const Pattern * p, int step)
+{
+	int delay = patternOffsets(p)[step];
+	if (step & 1) delay += p->swing;
+	if (delay > SEQ_HALF_RES) delay = SEQ_HALF_RES;
+	return delay;
+}
+
+int patternFind(const Pattern * p, int step)
+{
+// Skip the previous steps
+	const uint8_t * data = patternData(p);
+	int offset = 0;
+	for (int s = 0; s < step; s++) {
+		uint8_t mask = data[offset++];
+		for (int n = 0; n < SEQ_NOTES_MAX; n++) {
+			if ((mask & SLOT_BITS) == SLOT_NOTE) offset++;
+			mask >>= 2;
+		}
+	}
+	return offset;
+}
+
+bool patternSetSlot(Pattern * p, int step, int slot, uint8_t note)
+{
+// Locate the slot in the step
+	int offset = patternFind(p, step);
+	uint8_t mask = patternData(p)[offset];
+	int at = offset + 1;
+	for (int n = 0; n < slot; n++)
+		if (((mask >> (n << 1)) & SLOT_BITS) == SLOT_NOTE) at++;
+
+	int code = SLOT_EMPTY;
+	if (note == STEP_TIE) code = SLOT_TIE;
+	else if (note < STEP_EMPTY) code = SLOT_NOTE;
+	int old = (mask >> (slot << 1)) & SLOT_BITS;
+
+// Make room or remove the note byte
+	if (code == SLOT_NOTE && old != SLOT_NOTE) {
+		if (p->size >= PATTERN_DATA_MAX) return false;
+		if (!poolReserve(p, 1)) return false;
+		poolResize(p, 2 * p->length + at, 1);
+		p->size++;
+	}else if (code != SLOT_NOTE && old == SLOT_NOTE) {
+		poolResize(p, 2 * p->length + at, -1);
+		p->size--;
+	}
+	uint8_t * data = patternData(p);
+
+// Update the step
+	if (code == SLOT_NOTE) data[at] = note;
+	mask &= ~(SLOT_BITS << (slot << 1));
+	data[offset] = mask | (code << (slot << 1));
+	p->dirty = true;
+	return true;
+}
+
+/*****************************************************************************/
+/*
+ * Flash records: a header dword (root, length, id, flags),
+ * a size dword and the step data padded to dwords. When
+ * flagged, a swing dword and the step offsets follow,
+ * then the step gate lengths.
+ * They are appended in the pattern page until it is full.
+ * Legacy fixed size records are converted on load.
+ */
+uint8_t patternFlags(const Pattern * p)
+{
+// Timing and gates only when used
+	const uint8_t * offsets = patternOffsets(p);
+	const uint8_t * gates = patternGates(p);
+	uint8_t flags = p->swing ? PATTERN_TIMING : 0;
+	for (int s = 0; s < p->length; s++) {
+		if (offsets[s]) flags |= PATTERN_TIMING;
+		if (gates[s] != SEQ_HALF_RES) flags |= PATTERN_GATES;
+	}
+	return flags;
+}
+
+uint32_t patternRecord(uint32_t size, uint8_t length, uint8_t flags)
+{
+// Record bytes, all parts padded to dwords
+	uint32_t bytes = 8 + ((size + 3) & ~3);
+	if (flags & PATTERN_TIMING)
+		bytes += 4 + ((length + 3) & ~3);
+	if (flags & PATTERN_GATES)
+		bytes += (length + 3) & ~3;
+	return bytes;
+}
+
+uint32_t patternNext(uint32_t addr)
+{
+	uint32_t header;
+	uint8_t * bytes = (uint8_t *) &header;
+	storeRead32(addr, &header);
+	if (header == 0xFFFFFFFF) return 0;
+	if (header == 0x00000000 ||
+		!(bytes[3] & PATTERN_COMPACT))
+		return addr + STORE_PATTERN_SIZE;
+
+	uint32_t size;
+	storeRead32(addr + 4, &size);
+	if (size > PATTERN_DATA_MAX) return 0;
+	return addr + patternRecord(size, bytes[1], bytes[3]);
+}
+
 void patternLoad(uint32_t addr, Pattern * p)
 {
-	uint32_t src = addr;
-	uint32_t * dst = (uint32_t *) p;
-	for (int i = 0; i < sizeof(Pattern) / sizeof(uint32_t); i++) {
-		storeRead32(src, dst++);
-		src += sizeof(uint32_t);
+// Load a pattern header
+	uint32_t header;
+	uint8_t * bytes = (uint8_t *) &header;
+	storeRead32(addr, &header);
+
+// Check pattern content
+	uint8_t len = bytes[1];
+	uint8_t id	= bytes[2];
+	uint8_t flags = bytes[3];
+	if (len == 0 ||
+		len >= SEQ_STEPS_MAX ||
+		id != p->id)
+		return;
+
+	if (!(flags & PATTERN_COMPACT)) {
+		patternLoadLegacy(addr, p);
+		return;
+	}
+
+// Load the step data
+	uint32_t size;
+	storeRead32(addr + 4, &size);
+	if (size > PATTERN_DATA_MAX) return;
+	patternFree(p);
+	p->size = size;
+	p->length = len;
+	if (!patternAlloc(p)) return;
+	p->root = bytes[0];
+	p->flags = flags & ~(PATTERN_COMPACT | PATTERN_TIMING | PATTERN_GATES);
+	addr = patternRead(addr + 8, patternData(p), size);
+
+// Load the timing
+	uint8_t * offsets = patternOffsets(p);
+	uint8_t * gates = patternGates(p);
+	uint32_t swing = 0;
+	for (int s = 0; s < len; s++) {
+		offsets[s] = 0;
+		gates[s] = SEQ_HALF_RES;
+	}
+	if (flags & PATTERN_TIMING) {
+		storeRead32(addr, &swing);
+		addr = patternRead(addr + 4, offsets, len);
+	}
+	if (flags & PATTERN_GATES)
+		patternRead(addr, gates, len);
+	p->swing = swing & 0xFF;
+}
+
+void patternLoadLegacy(uint32_t addr, Pattern * p)
+{
+	uint32_t header;
+	uint8_t * bytes = (uint8_t *) &header;
+	storeRead32(addr, &header);
+
+	patternFree(p);
+	p->flags = 0;
+	p->swing = 0;
+	p->root = bytes[0];
+
+// Convert the fixed size steps
+	uint32_t src = addr + 4;
+	for (int s = 0; s < bytes[1]; s++) {
+		uint32_t dword;
+		storeRead32(src, &dword);
+		if (!patternAppend(p, (uint8_t *) &dword)) break;
+		src += 4;
 	}
 }
 
 void patternSave(uint32_t addr, const Pattern * p)
 {
-	uint32_t * src = (uint32_t *) p;
-	uint32_t dst = addr;
-	for (int i = 0; i < sizeof(Pattern) / sizeof(uint32_t); i++) {
-		storeWrite32(dst, src++);
-		dst += sizeof(uint32_t);
+	uint8_t flags = patternFlags(p);
+	uint32_t header;
+	uint8_t * bytes = (uint8_t *) &header;
+	bytes[0] = p->root;
+	bytes[1] = p->length;
+	bytes[2] = p->id;
+	bytes[3] = p->flags | PATTERN_COMPACT | flags;
+	uint32_t size = p->size;
+	storeWrite32(addr, &header);
+	storeWrite32(addr + 4, &size);
+	addr = patternWrite(addr + 8, patternData(p), p->size);
+
+	if (flags & PATTERN_TIMING) {
+		uint32_t swing = 0xFFFFFF00 | p->swing;
+		storeWrite32(addr, &swing);
+		addr = patternWrite(addr + 4, patternOffsets(p), p->length);
+	}
+	if (flags & PATTERN_GATES)
+		patternWrite(addr, patternGates(p), p->length);
+}
+
+uint32_t patternRead(uint32_t addr, uint8_t * dst, int count)
+{
+	for (int i = 0; i < count; i += 4) {
+		uint32_t dword;
+		uint8_t * data = (uint8_t *) &dword;
+		storeRead32(addr, &dword);
+		for (int j = 0; j < 4 && i + j < count; j++)
+			dst[i + j] = data[j];
+		addr += 4;
+	}
+	return addr;
+}
+
+uint32_t patternWrite(uint32_t addr, const uint8_t * src, int count)
+{
+	for (int i = 0; i < count; i += 4) {
+		uint32_t dword = 0xFFFFFFFF;
+		uint8_t * data = (uint8_t *) &dword;
+		for (int j = 0; j < 4 && i + j < count; j++)
+			data[j] = src[i + j];
+		storeWrite32(addr, &dword);
+		addr += 4;
 	}
+	return addr;
+}
+
+/*****************************************************************************/
+uint16_t timelineCount(const Pattern * p)
+{
+// One event per note byte, then the end mark
+	return p->size - p->length + 1;
+}
+
+bool timelinePlace(Timeline * t, uint16_t count)
+{
+	const Timeline * other = t == timeline ? timelineNext : timeline;
+	if (count + other->count > SEQ_EVENTS_POOL) return false;
+	t->events = t->top ? &seqEvents[SEQ_EVENTS_POOL - count] : seqEvents;
+	t->count = count;
+	return true;
+}
+
+void timelineCompile(Timeline * t, const Pattern * p, uint8_t root)
+{
+	Event * e = t->events;
+	int shift = 0;
+	if (root != NOTE_NONE)
+		shift = root - p->root;
+
+	uint8_t notes[SEQ_NOTES_MAX];
+	Event * tied[SEQ_NOTES_MAX];
+	for (int n = 0; n < SEQ_NOTES_MAX; n++)
+		tied[n] = 0;
+
+	const uint8_t * gates = patternGates(p);
+	const uint8_t * src = patternData(p);
+	for (int s = 0; s < p->length; s++) {
+		src = patternDecode(src, notes);
+		uint16_t pos = s * SEQ_STEP_RES + patternDelay(p, s);
+		uint16_t end = pos + gates[s];
+
+		for (int n = 0; n < SEQ_NOTES_MAX; n++) {
+			int note = notes[n];
+		// Ties extend the gate
+			if (note == STEP_TIE) {
+				if (tied[n]) tied[n]->gate = end - tied[n]->pos;
+				continue;
+			}
+			tied[n] = 0;
+			if (note == STEP_EMPTY) continue;
+
+		// Notes starting on the step
+			note += shift;
+			if (note < 0) note = 0;
+			if (note > 127) note = 127;
+			e->pos = pos;
+			e->gate = gates[s];
+			e->slot = n;
+			e->note = note;
+			tied[n] = e;
+			e++;
+		}
+	}
+
+// Ties wrapping around the loop
+	uint16_t loop = p->length * SEQ_STEP_RES;
+	src = patternData(p);
+	for (int s = 0; s < p->length; s++) {
+		src = patternDecode(src, notes);
+		uint16_t end = loop + s * SEQ_STEP_RES + patternDelay(p, s) + gates[s];
+		bool open = false;
+		for (int n = 0; n < SEQ_NOTES_MAX; n++) {
+			if (!tied[n]) continue;
+			if (notes[n] != STEP_TIE) {
+				tied[n] = 0;
+				continue;
+			}
+			uint16_t gate = end - tied[n]->pos;
+			tied[n]->gate = gate < loop ? gate : loop;
+			open = true;
+		}
+		if (!open) break;
+	}
+
+	e->pos = EVENT_END;
+	t->next = t->events;
+}
+
+void timelineSeek(Timeline * t, uint16_t pos)
+{
+	const Event * e = t->events;
+	while (e->pos < pos) e++;
+	t->next = e;
 }
 
 /*****************************************************************************/
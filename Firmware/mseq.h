@@ -25,10 +25,13 @@
 	#include <stdbool.h>
 
 /******************************************************************************/
-	#define SEQ_PATTERNS_MAX	16		// number of patterns
+	#define SEQ_PATTERNS_MAX	64		// number of patterns
 	#define SEQ_STEPS_MAX		96		// max: 127 steps
 	#define SEQ_NOTES_MAX		4		// notes per step
+	#define SEQ_CACHE_SLOTS		3		// patterns held in RAM
+	#define SEQ_CHAIN_MAX		64		// links in the song chain
 	#define SEQ_CLOCK_TIMEOUT	1500	// timeout for clock switching
+	#define MSEQ_ARP_OCTAVES_MAX	4	// arpeggiator octave range
 
 /******************************************************************************/
 /* States and configuration */
@@ -36,6 +39,7 @@
 		MSEQ_STATE_RESET = 0,
 		MSEQ_STATE_PLAY,
 		MSEQ_STATE_RECORD,
+		MSEQ_STATE_OVERDUB,
 	}MSEQ_STATES;
 
 	typedef enum {
@@ -48,18 +52,53 @@
 		MSEQ_CLOCK_DIV_4		= 0x8,
 	}MSEQ_CLOCKINGS;
 
+	typedef enum {
+		MSEQ_ARP_OFF = 0,
+		MSEQ_ARP_UP,
+		MSEQ_ARP_DOWN,
+		MSEQ_ARP_UPDOWN,
+		MSEQ_ARP_RANDOM,
+		MSEQ_ARP_PLAYED,
+	}MSEQ_ARP_MODES;
+
 /******************************************************************************/	
 /* Base and pattern functions */
 	void mseqInit();
 	void mseqUpdate();
+	bool mseqPending();
 	MSEQ_STATES mseqGetState();
 	
 	void mseqSetPattern(int pattern);
 	int mseqGetPattern();
 
+	void mseqSetSwing(int swing);
+	int mseqGetSwing();
+	void mseqSetOffset(int offset);
+	void mseqSetGate(int gate);
+
+/******************************************************************************/
+/* Song / chain functions */
+	void mseqSetChain(bool enabled);
+	bool mseqGetChain();
+	void mseqChainClear();
+	void mseqChainAppend(int pattern, int repeats);
+
+/******************************************************************************/
+/* Arpeggiator functions */
+	void mseqSetArp(int mode);
+	int mseqGetArp();
+	void mseqSetArpOctaves(int octaves);
+
+/******************************************************************************/
+/* Pattern import (sysex) */
+	void mseqImportBegin(int pattern);
+	void mseqImportByte(uint8_t b);
+	bool mseqImportEnd(bool commit);
+
 /******************************************************************************/
 /* Clock related functions */
 	void mseqSetClocking(int config);
+	void mseqSetTempo(int bpm);
 	int mseqGetClocking();
 	
 	void mseqMIDITick();
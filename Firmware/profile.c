@@ -0,0 +1,135 @@
+/**
+ * ZeKit Firmware v2.0
+ * Copyright (C) 2021/2022 - Frdric Meslin
+ * Contact: fred@fredslab.net
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.	 If not, see <https://www.gnu.org/licenses/>.
+ */
+/******************************************************************************/
+
+#include "profile.h"
+#include "config.h"
+
+#include <xc.h>
+#include <stdint.h>
+
+#ifdef PROFILE
+
+/******************************************************************************/
+Profile profile;
+static uint32_t profileStamp;
+
+static void profileAccumulate(ProfileTask * task, uint32_t cycles);
+
+/******************************************************************************/
+void profileInit()
+{
+// Free running 32-bit cycle counter (SCCP4)
+	PMD2bits.CCP4MD = 0;
+	CCP4CON1L = 0;
+	CCP4CON1H = 0;
+	CCP4CON1Lbits.T32 = 1;		// 32-bit timer
+	CCP4CON1Lbits.CLKSEL = 0;	// System clock (FCY)
+	CCP4CON1Lbits.TMRPS = 0;	// No prescaler
+	CCP4PRL = 0xFFFF;
+	CCP4PRH = 0xFFFF;
+	CCP4TMRL = 0;
+	CCP4TMRH = 0;
+	CCP4CON1Lbits.CCPON = 1;
+
+	profileReset();
+}
+
+void profileReset()
+{
+	uint8_t * p = (uint8_t *) &profile;
+	for (int i = 0; i < sizeof(Profile); i++)
+		p[i] = 0;
+	profileStamp = profileCycles();
+}
+
+uint32_t profileCycles()
+{
+	uint16_t high, low;
+	do {
+		high = CCP4TMRH;
+		low = CCP4TMRL;
+	} while (high != CCP4TMRH);
+	return ((uint32_t) high << 16) | low;
+}
+
+/******************************************************************************/
+void profileLoop()
+{
+	uint32_t now = profileCycles();
+	uint32_t period = now - profileStamp;
+	profileStamp = now;
+	profileAccumulate(&profile.loop, period);
+
+// Fill the histogram
+	int bin = 0;
+	period >>= PROFILE_BIN_SHIFT;
+	while (period && bin < PROFILE_BINS - 1) {
+		period >>= 1;
+		bin++;
+	}
+	if (profile.bins[bin] != 0xFFFF)
+		profile.bins[bin]++;
+}
+
+void profileTask(int task, uint32_t start)
+{
+	profileAccumulate(&profile.tasks[task], profileCycles() - start);
+}
+
+void profileMIDI(uint16_t bytes, uint32_t cycles)
+{
+	if (!bytes) return;
+	ProfileMIDI * m = &profile.midi;
+	if (m->bytes > 0xFFFFFFFFUL - bytes ||
+		m->cycles > 0xFFFFFFFFUL - cycles) {
+		m->bytes >>= 1;
+		m->cycles >>= 1;
+	}
+	m->bytes += bytes;
+	m->cycles += cycles;
+	if (cycles > m->burstCycles) {
+		m->burstCycles = cycles;
+		m->burst = bytes;
+	}
+}
+
+uint32_t profileMean(const ProfileTask * task)
+{
+	if (!task->count) return 0;
+	return task->sum / task->count;
+}
+
+/******************************************************************************/
+void profileAccumulate(ProfileTask * task, uint32_t cycles)
+{
+	task->last = cycles;
+	if (cycles > task->max)
+		task->max = cycles;
+
+// Moving mean
+	if (task->count == 0x8000 || task->sum > 0x7FFFFFFFUL - cycles) {
+		task->sum >>= 1;
+		task->count >>= 1;
+	}
+	task->sum += cycles;
+	task->count++;
+}
+
+#endif
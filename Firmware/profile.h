@@ -0,0 +1,81 @@
+/**
+ * ZeKit Firmware v2.0
+ * Copyright (C) 2021/v2.0 - Frdric Meslin
+ * Contact: fred@fredslab.net
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.	 If not, see <https://www.gnu.org/licenses/>.
+ */
+/******************************************************************************/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+	#include "sched.h"
+	#include "config.h"
+	#include <stdint.h>
+
+/******************************************************************************/
+	#define PROFILE_BINS		16		// Loop period histogram (log2)
+	#define PROFILE_BIN_SHIFT	5		// First bin below 32 cycles
+
+/*
+ * Main loop profile, in CPU cycles (interrupts included).
+ * Bin n of the histogram counts the loop periods between
+ * 2^(n + 4) and 2^(n + 5) cycles, the last bin catches
+ * all the longer ones. Counters saturate, sums and counts
+ * are halved together to keep a moving mean.
+ */
+	typedef struct {
+		uint32_t last, max;
+		uint32_t sum;
+		uint16_t count;
+	}ProfileTask;
+
+/*
+ * MIDI parsing: bytes and cycles in total (mean cost per
+ * byte), and the longest drain of the ring with its size.
+ */
+	typedef struct {
+		uint32_t bytes, cycles;
+		uint16_t burst;
+		uint32_t burstCycles;
+	}ProfileMIDI;
+
+	typedef struct {
+		ProfileTask tasks[SCHED_TASKS];
+		ProfileTask loop;
+		uint16_t bins[PROFILE_BINS];
+		ProfileMIDI midi;
+	}Profile;
+
+/******************************************************************************/
+#ifdef PROFILE
+	extern Profile profile;
+
+	void profileInit();
+	void profileReset();
+	uint32_t profileCycles();
+	void profileLoop();
+	void profileTask(int task, uint32_t start);
+	void profileMIDI(uint16_t bytes, uint32_t cycles);
+	uint32_t profileMean(const ProfileTask * task);
+
+	#define PROFILE_RUN(task, call)		{uint32_t start = profileCycles(); call; profileTask(task, start);}
+#else
+	#define profileInit()
+	#define profileLoop()
+	#define PROFILE_RUN(task, call)		call
+#endif
+
+#endif
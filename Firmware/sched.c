@@ -0,0 +1,132 @@
+/**
+ * ZeKit Firmware v2.0
+ * Copyright (C) 2021/2022 - Frdric Meslin
+ * Contact: fred@fredslab.net
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.	 If not, see <https://www.gnu.org/licenses/>.
+ */
+/******************************************************************************/
+
+#include "sched.h"
+#include "midi.h"
+#include "mseq.h"
+#include "audio.h"
+#include "store.h"
+#include "ui.h"
+#include "profile.h"
+
+#include "config.h"
+
+#include <xc.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+SchedTask schedTasks[SCHED_TASKS] = {
+	{.update = midiUpdate,	.pending = midiPending,	.period = 0,				.deadline = SCHED_MS(1)},
+	{.update = mseqUpdate,	.pending = mseqPending,	.period = 0,				.deadline = SCHED_US(250)},
+	{.update = audioUpdate,	.pending = 0,			.period = SCHED_MS(1),		.deadline = SCHED_MS(1)},
+	{.update = uiUpdate,	.pending = 0,			.period = SCHED_MS(10),		.deadline = SCHED_MS(10)},
+	{.update = storeUpdate,	.pending = storePending,.period = 0,				.deadline = SCHED_MS(50)},
+};
+
+uint32_t schedIdle;
+uint8_t schedUsage;
+static uint32_t schedIdleSum;
+static uint16_t schedSecond;
+
+static void schedSleep();
+
+/******************************************************************************/
+void schedInit()
+{
+	uint32_t now = timeNow();
+	for (int i = 0; i < SCHED_TASKS; i++) {
+		SchedTask * t = &schedTasks[i];
+		t->release = now + t->period;
+		t->waiting = false;
+		t->latency = 0;
+		t->latencyMax = 0;
+		t->overruns = 0;
+	}
+
+	schedIdle = 0;
+	schedUsage = 100;
+	schedIdleSum = 0;
+	schedSecond = uwTick;
+}
+
+void schedUpdate()
+{
+	uint32_t now = timeNow();
+	SchedTask * next = 0;
+	int nextId = 0;
+
+// Usage over the last second
+	if ((uint16_t) (uwTick - schedSecond) >= FRQ_TICK) {
+		schedSecond += FRQ_TICK;
+		schedIdle = schedIdleSum;
+		schedIdleSum = 0;
+		if (schedIdle > FRQ_TIME) schedIdle = FRQ_TIME;
+		schedUsage = 100 - (schedIdle * 100) / FRQ_TIME;
+	}
+
+// Release the tasks
+	for (int i = 0; i < SCHED_TASKS; i++) {
+		SchedTask * t = &schedTasks[i];
+		if (!t->waiting) {
+			if (t->period && (int32_t) (now - t->release) >= 0) {
+				t->ready = t->release;
+				t->release += t->period;
+				if ((int32_t) (now - t->release) >= 0)
+					t->release = now + t->period;	// Skip the missed periods
+				t->waiting = true;
+			}else if (t->pending && t->pending()) {
+				t->ready = now;
+				t->waiting = true;
+			}
+		}
+
+	// Earliest deadline first
+		if (!t->waiting) continue;
+		if (!next || (int32_t) ((t->ready + t->deadline) - (next->ready + next->deadline)) < 0) {
+			next = t;
+			nextId = i;
+		}
+	}
+	if (!next) {
+		schedSleep();
+		return;
+	}
+
+// Account the latency
+	uint32_t latency = now - next->ready;
+	if (latency > 0xFFFF) latency = 0xFFFF;
+	next->latency = latency;
+	if (latency > next->latencyMax) next->latencyMax = latency;
+	if (latency > next->deadline) next->overruns++;
+
+// Run the task
+	next->waiting = false;
+	PROFILE_RUN(nextId, next->update());
+}
+
+/******************************************************************************/
+void schedSleep()
+{
+// Wait for the next interrupt
+	uint32_t start = timeNow();
+	Idle();
+	schedIdleSum += timeNow() - start;
+}
@@ -0,0 +1,72 @@
+/**
+ * ZeKit Firmware v2.0
+ * Copyright (C) 2021/v2.0 - Frdric Meslin
+ * Contact: fred@fredslab.net
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.	 If not, see <https://www.gnu.org/licenses/>.
+ */
+/******************************************************************************/
+
+#ifndef SCHED_H
+#define SCHED_H
+
+	#include "config.h"
+	#include <stdint.h>
+	#include <stdbool.h>
+
+/******************************************************************************/
+	#define SCHED_US(us)		((uint32_t) (us) * FRQ_TIME / 1000000UL)
+	#define SCHED_MS(ms)		((uint32_t) (ms) * TIME_PER_TICK)
+
+	typedef enum {
+		SCHED_MIDI = 0,
+		SCHED_MSEQ,
+		SCHED_AUDIO,
+		SCHED_UI,
+		SCHED_STORE,
+		SCHED_TASKS,
+	}SCHED_TASKS_ENUM;
+
+/*
+ * Tasks are released on their period or when their event
+ * source is pending, then run one at a time, the earliest
+ * deadline first. Times are in Timer1 counts (4us); a task
+ * started after its deadline counts an overrun.
+ */
+	typedef struct {
+		void (*update)();
+		bool (*pending)();		// Event source (or 0)
+		uint32_t period;		// Release period (or 0)
+		uint32_t deadline;		// Allowed latency
+		uint32_t release;		// Next periodic release
+		uint32_t ready;			// Release time (when waiting)
+		bool waiting;
+		uint16_t latency, latencyMax;
+		uint16_t overruns;
+	}SchedTask;
+	extern SchedTask schedTasks[SCHED_TASKS];
+
+/*
+ * The CPU idles when no task is ready and wakes up on the
+ * next interrupt (audio block, tick, clocks). Idle time is
+ * summed over each second, in Timer1 counts.
+ */
+	extern uint32_t schedIdle;
+	extern uint8_t schedUsage;		// CPU usage (%)
+
+/******************************************************************************/
+	void schedInit();
+	void schedUpdate();
+
+#endif
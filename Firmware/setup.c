@@ -116,6 +116,7 @@ void setupGPIOs()
 	IOCPB = 0;
 
 	PADCONbits.IOCON = 1;
+	IPC4bits.IOCIP = 2;			// Below Timer1 (timeNow)
 	IEC1bits.IOCIE = 1;
 
 // Peripherals to pins mapping
@@ -228,9 +229,13 @@ void setupComp()
 	CM1CON = 0;					// Reset the comparator module
 	CM1CONbits.CON = 1;			// Enable voltage comparator
 	CM1CONbits.CPOL = 1;		// Inverse polarity
-	CM1CONbits.EVPOL = 0;		// No event generation
+	CM1CONbits.EVPOL = 1;		// Event on output rising edge
 	CM1CONbits.CREF = 1;		// Use the voltage reference
 	CM1CONbits.CCH = 0;			// Monitor C1INB pin
+
+	IFS1bits.CMIF = 0;
+	IPC4bits.CMIP = 4;			// Same as the render (envelopes)
+	IEC1bits.CMIE = 1;			// Enable the interrupt
 }
 
 void setupDMA()
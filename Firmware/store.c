@@ -27,25 +27,116 @@
 /******************************************************************************/
 /* Reserved flash memory */
 const int8_t __attribute__ ((section(".globals"),  noload, address(GLOBALS_ADDR))) flashGlobals[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x0000))) flashPatternsPage1[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x0800))) flashPatternsPage2[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x1000))) flashPatternsPage3[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x1800))) flashPatternsPage4[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x2000))) flashPatternsPage5[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x2800))) flashPatternsPage6[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x3000))) flashPatternsPage7[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x3800))) flashPatternsPage8[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x4000))) flashPatternsPage9[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x4800))) flashPatternsPage10[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x5000))) flashPatternsPage11[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x5800))) flashPatternsPage12[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x6000))) flashPatternsPage13[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x6800))) flashPatternsPage14[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x7000))) flashPatternsPage15[FLASH_PAGE_SIZE];
-const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x7800))) flashPatternsPage16[FLASH_PAGE_SIZE];
+const int8_t __attribute__ ((section(".chain"),    noload, address(CHAIN_ADDR))) flashChain[FLASH_PAGE_SIZE];
+const int8_t __attribute__ ((section(".ccmap"),    noload, address(CCMAP_ADDR))) flashCCMap[FLASH_PAGE_SIZE];
+const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x00000))) flashPatternsBank1[FLASH_PAGE_SIZE * 8];
+const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x04000))) flashPatternsBank2[FLASH_PAGE_SIZE * 8];
+const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x08000))) flashPatternsBank3[FLASH_PAGE_SIZE * 8];
+const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x0C000))) flashPatternsBank4[FLASH_PAGE_SIZE * 8];
+const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x10000))) flashPatternsBank5[FLASH_PAGE_SIZE * 8];
+const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x14000))) flashPatternsBank6[FLASH_PAGE_SIZE * 8];
+const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x18000))) flashPatternsBank7[FLASH_PAGE_SIZE * 8];
+const int8_t __attribute__ ((section(".patterns"), noload, address(PATTERNS_ADDR+0x1C000))) flashPatternsBank8[FLASH_PAGE_SIZE * 8];
+
+/******************************************************************************/
+/* Deferred operations */
+typedef struct {
+	uint32_t addr;
+	uint16_t first;		// First queued dword
+	uint16_t count;		// Dwords to write (0: erase)
+} StoreRun;
+
+static uint32_t storeQueue[STORE_QUEUE_LEN];
+static StoreRun storeRuns[STORE_RUNS_MAX];
+static uint16_t storeQueued;
+static uint16_t storeRunsCount;
+static uint16_t storeRunRd;
+static uint16_t storeRunPos;
+
+static bool storeReadQueued(uint32_t addr, uint32_t * dword);
+static void storeEraseNow(uint32_t addr);
+static void storeWriteNow(uint32_t addr, const uint32_t * dword);
 
 /******************************************************************************/
 void storeErasePage(uint32_t addr)
+{
+	if (storeRunsCount >= STORE_RUNS_MAX) storeFlush();
+	StoreRun * r = &storeRuns[storeRunsCount++];
+	r->addr = addr;
+	r->first = storeQueued;
+	r->count = 0;
+}
+
+void storeWrite32(uint32_t addr, const uint32_t * dword)
+{
+	if (storeQueued >= STORE_QUEUE_LEN) storeFlush();
+
+// Extend the last run or start a new one
+	StoreRun * r = storeRunsCount ? &storeRuns[storeRunsCount - 1] : 0;
+	if (!r || !r->count || r->addr + r->count * 4 != addr) {
+		if (storeRunsCount >= STORE_RUNS_MAX) storeFlush();
+		r = &storeRuns[storeRunsCount++];
+		r->addr = addr;
+		r->first = storeQueued;
+		r->count = 0;
+	}
+	storeQueue[storeQueued++] = *dword;
+	r->count++;
+}
+
+/******************************************************************************/
+void storeUpdate()
+{
+	if (storeRunRd >= storeRunsCount) return;
+
+// One erase or one dword per call
+	StoreRun * r = &storeRuns[storeRunRd];
+	if (!r->count) {
+		storeEraseNow(r->addr);
+		storeRunRd++;
+	}else{
+		storeWriteNow(r->addr + storeRunPos * 4, &storeQueue[r->first + storeRunPos]);
+		if (++storeRunPos >= r->count) {
+			storeRunPos = 0;
+			storeRunRd++;
+		}
+	}
+
+// Queue completed
+	if (storeRunRd < storeRunsCount) return;
+	storeRunsCount = 0;
+	storeRunRd = 0;
+	storeQueued = 0;
+}
+
+bool storePending() {return storeRunsCount != 0;}
+
+void storeFlush()
+{
+	while (storeRunsCount)
+		storeUpdate();
+}
+
+bool storeReadQueued(uint32_t addr, uint32_t * dword)
+{
+// Latest queued operation on the address
+	uint16_t i = storeRunsCount;
+	while (i > storeRunRd) {
+		const StoreRun * r = &storeRuns[--i];
+		if (!r->count) {
+			if ((addr ^ r->addr) & ~(uint32_t) (FLASH_PAGE_SIZE - 1)) continue;
+			*dword = 0xFFFFFFFF;
+			return true;
+		}
+		if (addr < r->addr || addr >= r->addr + r->count * 4) continue;
+		*dword = storeQueue[r->first + (uint16_t) (addr - r->addr) / 4];
+		return true;
+	}
+	return false;
+}
+
+/******************************************************************************/
+void storeEraseNow(uint32_t addr)
 {
 	NVMCON = 0x4003; // Erase full page
 	TBLPAG = 0x00;
@@ -59,6 +150,7 @@ void storeErasePage(uint32_t addr)
 
 void storeRead32(uint32_t addr, uint32_t * dword)
 {
+	if (storeReadQueued(addr, dword)) return;
 	uint16_t addrHigh = (uint16_t) (addr >> 16);
 	uint16_t addrLow  = (uint16_t) (addr);
 	TBLPAG = addrHigh;
@@ -68,7 +160,7 @@ void storeRead32(uint32_t addr, uint32_t * dword)
 	data[1] = __builtin_tblrdl(addrLow + 2);
 }
 
-void storeWrite32(uint32_t addr, const uint32_t * dword)
+void storeWriteNow(uint32_t addr, const uint32_t * dword)
 {
 	NVMCON = 0x4001; // Write double word
 	TBLPAG = 0xFA;
@@ -22,6 +22,7 @@
 #define STORE_H
 
 	#include <stdint.h>
+	#include <stdbool.h>
 
 /******************************************************************************/
 	#define FLASH_ROW_SIZE				(128u * 2)
@@ -32,15 +33,29 @@
 	#define GLOBAL_MIDICHANNEL_ADDR		(GLOBALS_ADDR + 0)
 	#define GLOBAL_CLOCKING_ADDR		(GLOBALS_ADDR + 4)	
 	#define GLOBAL_FRCTUNING_ADDR		(GLOBALS_ADDR + 8)
+	#define CHAIN_ADDR					(0x7000u)
+	#define CCMAP_ADDR					(0x6800u)
 	#define PATTERNS_ADDR				(0x8000u)
 
-	#define STORE_PATTERN_SIZE			(FLASH_ROW_SIZE * 2)
+	#define STORE_PATTERN_SIZE			(FLASH_ROW_SIZE * 2)	// Legacy records
 	#define STORE_PATTERNS_PER_PAGE		(FLASH_PAGE_SIZE / STORE_PATTERN_SIZE)
-	#define STORE_PATTERNS_ADDR(p)		(PATTERNS_ADDR + (p) * FLASH_PAGE_SIZE)
+	#define STORE_PATTERNS_ADDR(p)		(PATTERNS_ADDR + (uint32_t) (p) * FLASH_PAGE_SIZE)
+
+	#define STORE_QUEUE_LEN				192		// Deferred dwords
+	#define STORE_RUNS_MAX				8		// Deferred erases / runs
 
 /******************************************************************************/
+/*
+ * Erases and writes are queued and performed one page erase
+ * or one dword at a time by storeUpdate, so that a save does
+ * not hold the main loop. Reads return the queued data.
+ */
 	void storeErasePage(uint32_t addr);
 	void storeRead32(uint32_t addr, uint32_t * dword);
 	void storeWrite32(uint32_t addr, const uint32_t * dword);
 
+	void storeUpdate();
+	bool storePending();
+	void storeFlush();
+
 #endif
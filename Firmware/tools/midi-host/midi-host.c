@@ -0,0 +1,625 @@
+/**
+ * ZeKit Firmware v2.0
+ * Copyright (C) 2021/2022 - Frdric Meslin
+ * Contact: fred@fredslab.net
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.	 If not, see <https://www.gnu.org/licenses/>.
+ */
+/******************************************************************************/
+
+/*
+ * Host test of the MIDI parser (midi.c), built with stubbed
+ * sequencer and audio functions that log their calls:
+ *	cc -O2 -fsanitize=address,undefined -I. -I../.. -o midi-host midi-host.c
+ *	./midi-host [seeds] [bytes]
+ * Random traffic is parsed by midi.c and by a plain switch
+ * based parser (refParse), their calls must be identical.
+ * It mixes channel messages (running status, any channel),
+ * realtime bytes anywhere, system common messages, stray
+ * sysex begin and end bytes, and sysex frames: ZeKit
+ * patterns, globals and CC maps (good or bad checksum, cut
+ * by a status byte) and foreign messages.
+ * Both parsers are then timed on dense traffic: clock at
+ * 24 PPQN, notes, CCs and pitch bend, on and off channel
+ * (build without the sanitizers for the timings).
+ * Exits with 1 when a seed fails.
+ */
+
+#include "../../midi.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/******************************************************************************/
+// Call log
+typedef struct {
+	const char * name;
+	int a, b;
+} Call;
+
+#define LOG_MAX		(1 << 20)
+static Call calls[LOG_MAX];
+static int callsCount;
+static bool logging = true;
+
+static void logCall(const char * name, int a, int b);
+
+/******************************************************************************/
+// Reference parser
+static uint8_t	refStatus;			// Running status (0: none)
+static uint8_t	refData[2];
+static uint8_t	refCount;
+static bool		refSysEx;
+static uint32_t refSysExPos;
+static bool		refSysExOurs;		// ZeKit header
+static uint8_t	refSysExCommand;
+static uint8_t	refSysExHigh;		// Pending nibble
+static uint8_t	refSysExSum;
+static uint8_t	refSysExBytes[3];
+static uint16_t refSysExCount;
+static uint8_t	refMap[128];
+
+static void refInit();
+static void refDefaultMap();
+static void refParse(uint8_t b);
+static int refLength(uint8_t status);
+static void refMessage();
+static void refControl(uint8_t cc, uint8_t value);
+static void refSysExByte(uint8_t b);
+static void refSysExEnd(bool complete);
+
+/******************************************************************************/
+// Traffic
+static uint32_t rnd;
+
+static uint32_t rndNext();
+static int fuzzTraffic(uint8_t * data, int len);
+static int fuzzSysEx(uint8_t * data, int len);
+static int denseTraffic(uint8_t * data, int len);
+static bool fuzzSeed(uint32_t seed, int len);
+static double benchParser(void (*parse)(uint8_t), const uint8_t * data, int len);
+
+/******************************************************************************/
+// Firmware stubs
+volatile uint16_t DMACNT1;
+uint16_t uiSystem;
+
+void storeErasePage(uint32_t addr) {}
+void storeRead32(uint32_t addr, uint32_t * dword) {*dword = 0xFFFFFFFF;}
+void storeWrite32(uint32_t addr, const uint32_t * dword) {}
+
+void mseqNoteOn(uint8_t note) {logCall("mseqNoteOn", note, 0);}
+void mseqNoteOff(uint8_t note) {logCall("mseqNoteOff", note, 0);}
+void mseqMIDITick() {logCall("mseqMIDITick", 0, 0);}
+void mseqMIDIStart() {logCall("mseqMIDIStart", 0, 0);}
+void mseqMIDIContinue() {logCall("mseqMIDIContinue", 0, 0);}
+void mseqMIDIStop() {logCall("mseqMIDIStop", 0, 0);}
+void mseqSetPattern(int pattern) {logCall("mseqSetPattern", pattern, 0);}
+int mseqGetPattern() {return 5;}
+void mseqSetChain(bool enabled) {logCall("mseqSetChain", enabled, 0);}
+void mseqChainClear() {logCall("mseqChainClear", 0, 0);}
+void mseqChainAppend(int pattern, int repeats) {logCall("mseqChainAppend", pattern, repeats);}
+void mseqSetSwing(int swing) {logCall("mseqSetSwing", swing, 0);}
+void mseqSetOffset(int offset) {logCall("mseqSetOffset", offset, 0);}
+void mseqSetGate(int gate) {logCall("mseqSetGate", gate, 0);}
+void mseqSetArp(int mode) {logCall("mseqSetArp", mode, 0);}
+void mseqSetArpOctaves(int octaves) {logCall("mseqSetArpOctaves", octaves, 0);}
+void mseqSetClocking(int config) {logCall("mseqSetClocking", config, 0);}
+int mseqGetClocking() {return 3;}
+void mseqSetTempo(int bpm) {logCall("mseqSetTempo", bpm, 0);}
+void mseqImportBegin(int pattern) {logCall("mseqImportBegin", pattern, 0);}
+void mseqImportByte(uint8_t b) {logCall("mseqImportByte", b, 0);}
+bool mseqImportEnd(bool commit) {logCall("mseqImportEnd", commit, 0); return commit;}
+
+void audioSetWheel(int16_t wheel) {logCall("audioSetWheel", wheel, 0);}
+void audioSetWave(int wave) {logCall("audioSetWave", wave, 0);}
+void audioSetCutoff(int16_t cutoff) {logCall("audioSetCutoff", cutoff, 0);}
+void audioSetBend(int16_t bend) {logCall("audioSetBend", bend, 0);}
+void audioSetPriority(int prio) {logCall("audioSetPriority", prio, 0);}
+void audioSetGlide(int glide) {logCall("audioSetGlide", glide, 0);}
+void audioSetVibratoRate(int rate) {logCall("audioSetVibratoRate", rate, 0);}
+void audioAllNotesOff() {logCall("audioAllNotesOff", 0, 0);}
+void audioAllSoundsOff() {logCall("audioAllSoundsOff", 0, 0);}
+void audioResetCtrls() {logCall("audioResetCtrls", 0, 0);}
+
+void uiFRCTuning(int value) {logCall("uiFRCTuning", value, 0);}
+void uiSetGlobals(int channel, int clocking, int tuning) {logCall("uiSetGlobals", channel, clocking << 8 | tuning);}
+
+/******************************************************************************/
+int main(int argc, char ** argv)
+{
+	int seeds = argc > 1 ? atoi(argv[1]) : 20;
+	int len = argc > 2 ? atoi(argv[2]) : 100000;
+
+// Compare with the reference parser
+	int failed = 0;
+	for (int s = 1; s <= seeds; s++)
+		if (!fuzzSeed(s, len)) failed++;
+	printf("fuzz: %d / %d seeds identical (%d bytes each)\n", seeds - failed, seeds, len);
+
+// Time the parsers
+	static uint8_t data[1 << 20];
+	int count = denseTraffic(data, sizeof(data));
+	midiInit();
+	refInit();
+	logging = false;
+	double tNew = benchParser(midiParse, data, count);
+	double tRef = benchParser(refParse, data, count);
+	logging = true;
+	printf("bench: %d bytes, table parser %.2f ns/byte, switch parser %.2f ns/byte\n",
+		count, tNew, tRef);
+	printf("bench: 64 byte ring drained in %.2f us (host)\n", tNew * 64 / 1000);
+	return failed ? 1 : 0;
+}
+
+/******************************************************************************/
+void logCall(const char * name, int a, int b)
+{
+	if (!logging || callsCount >= LOG_MAX) return;
+	Call * c = &calls[callsCount++];
+	c->name = name;
+	c->a = a;
+	c->b = b;
+}
+
+/******************************************************************************/
+void refInit()
+{
+	refStatus = 0;
+	refCount = 0;
+	refSysEx = false;
+	refDefaultMap();
+}
+
+void refDefaultMap()
+{
+	for (int i = 0; i < 128; i++)
+		refMap[i] = MIDI_PARAM_NONE;
+	refMap[MIDI_CC_MODWHEEL] = MIDI_PARAM_WHEEL;
+	refMap[MIDI_CC_GLIDE] = MIDI_PARAM_GLIDE;
+	refMap[MIDI_CC_WAVE] = MIDI_PARAM_WAVE;
+	refMap[MIDI_CC_PATTERN] = MIDI_PARAM_PATTERN;
+	refMap[MIDI_CC_CUTOFF] = MIDI_PARAM_CUTOFF;
+	refMap[MIDI_CC_VIBRATO_RATE] = MIDI_PARAM_VIBRATO_RATE;
+	refMap[MIDI_CC_VIBRATO_DEPTH] = MIDI_PARAM_VIBRATO_DEPTH;
+	refMap[MIDI_CC_CHAIN] = MIDI_PARAM_CHAIN;
+	refMap[MIDI_CC_CHAIN_EDIT] = MIDI_PARAM_CHAIN_EDIT;
+	refMap[MIDI_CC_SWING] = MIDI_PARAM_SWING;
+	refMap[MIDI_CC_STEP_OFFSET] = MIDI_PARAM_STEP_OFFSET;
+	refMap[MIDI_CC_STEP_GATE] = MIDI_PARAM_STEP_GATE;
+	refMap[MIDI_CC_ARP] = MIDI_PARAM_ARP;
+	refMap[MIDI_CC_ARP_OCTAVES] = MIDI_PARAM_ARP_OCTAVES;
+	refMap[MIDI_CC_NOTE_PRIORITY] = MIDI_PARAM_NOTE_PRIORITY;
+	refMap[MIDI_CC_SYSTEM] = MIDI_PARAM_SYSTEM;
+	refMap[MIDI_CC_CLOCK_DIV] = MIDI_PARAM_CLOCK_DIV;
+	refMap[MIDI_CC_TEMPO] = MIDI_PARAM_TEMPO;
+	refMap[MIDI_CC_ALLSOUNDSOFF] = MIDI_PARAM_ALLSOUNDSOFF;
+	refMap[MIDI_CC_RESETCTRLS] = MIDI_PARAM_RESETCTRLS;
+	refMap[MIDI_CC_ALLNOTESOFF] = MIDI_PARAM_ALLNOTESOFF;
+}
+
+void refParse(uint8_t b)
+{
+// Realtime messages, anywhere
+	if (b >= 0xF8) {
+		switch(b) {
+		case MIDI_TICK: mseqMIDITick(); break;
+		case MIDI_START: mseqMIDIStart(); break;
+		case MIDI_CONTINUE: mseqMIDIContinue(); break;
+		case MIDI_STOP: mseqMIDIStop(); break;
+		default: break;
+		} return;
+	}
+
+// Sysex data
+	if (!(b & 0x80)) {
+		if (refSysEx) {
+			refSysExByte(b);
+			return;
+		}
+
+	// Message data
+		if (!refStatus) return;
+		refData[refCount++] = b;
+		if (refCount < refLength(refStatus)) return;
+		refCount = 0;
+		if (refStatus >= 0xF0) refStatus = 0;
+		else refMessage();
+		return;
+	}
+
+// Status bytes end the sysex and the running status
+	if (refSysEx) refSysExEnd(b == MIDI_SYSEX_END);
+	refSysEx = false;
+	refStatus = 0;
+	refCount = 0;
+
+	switch (b) {
+	case MIDI_SYSEX_BEGIN:
+		refSysEx = true;
+		refSysExPos = 0;
+		break;
+	case 0xF1: case 0xF2: case 0xF3:
+		refStatus = b;
+		break;
+	case 0xF4: case 0xF5: case 0xF6:
+	case MIDI_SYSEX_END:
+		break;
+	default:
+		refStatus = b;
+		break;
+	}
+}
+
+int refLength(uint8_t status)
+{
+// Data bytes after the status
+	switch (status & 0xF0) {
+	case MIDI_PROGRAM:
+	case MIDI_PRESSURE:
+		return 1;
+	case 0xF0:
+		if (status == 0xF2) return 2;
+		return 1;
+	default:
+		return 2;
+	}
+}
+
+void refMessage()
+{
+	int status = refStatus & 0xF0;
+	int channel = refStatus & 0x0F;
+	if (channel != midiChannel) return;
+
+	switch(status) {
+	case MIDI_NOTE_ON:
+		if (refData[1]) mseqNoteOn(refData[0]);
+		else mseqNoteOff(refData[0]);
+		break;
+
+	case MIDI_NOTE_OFF:
+		mseqNoteOff(refData[0]);
+		break;
+
+	case MIDI_CC:
+		refControl(refData[0], refData[1]);
+		break;
+
+	case MIDI_PITCHBEND:
+		audioSetBend((refData[1] << 7) | refData[0]);
+		break;
+
+	default: break;
+	}
+}
+
+void refControl(uint8_t cc, uint8_t value)
+{
+	switch(refMap[cc]) {
+	case MIDI_PARAM_WHEEL:
+		audioSetWheel(value);
+		uiFRCTuning(value);
+		break;
+	case MIDI_PARAM_WAVE: audioSetWave(value >> 3); break;
+	case MIDI_PARAM_PATTERN: mseqSetPattern(value >> 1); break;
+	case MIDI_PARAM_CUTOFF: audioSetCutoff(value); break;
+	case MIDI_PARAM_CHAIN: mseqSetChain(value >= 64); break;
+	case MIDI_PARAM_CHAIN_EDIT:
+		if (!value) mseqChainClear();
+		else mseqChainAppend(mseqGetPattern(), value);
+		break;
+	case MIDI_PARAM_SWING: mseqSetSwing(value); break;
+	case MIDI_PARAM_STEP_OFFSET: mseqSetOffset(value); break;
+	case MIDI_PARAM_STEP_GATE: mseqSetGate(value << 1); break;
+	case MIDI_PARAM_ARP: mseqSetArp(value >> 4); break;
+	case MIDI_PARAM_ARP_OCTAVES: mseqSetArpOctaves((value >> 5) + 1); break;
+	case MIDI_PARAM_NOTE_PRIORITY: audioSetPriority(value >> 5); break;
+	case MIDI_PARAM_GLIDE: audioSetGlide(value); break;
+	case MIDI_PARAM_VIBRATO_RATE: audioSetVibratoRate(value); break;
+	case MIDI_PARAM_VIBRATO_DEPTH: audioSetWheel(value); break;
+	case MIDI_PARAM_SYSTEM: uiSystem = value >> 3; break;
+	case MIDI_PARAM_CLOCK_DIV:
+		if (value < 43) mseqSetClocking((mseqGetClocking() & MSEQ_CLOCK_TAKE_BOTH) | MSEQ_CLOCK_DIV_0);
+		else if (value < 86) mseqSetClocking((mseqGetClocking() & MSEQ_CLOCK_TAKE_BOTH) | MSEQ_CLOCK_DIV_2);
+		else mseqSetClocking((mseqGetClocking() & MSEQ_CLOCK_TAKE_BOTH) | MSEQ_CLOCK_DIV_4);
+		break;
+	case MIDI_PARAM_TEMPO: mseqSetTempo(60 + value); break;
+	case MIDI_PARAM_ALLSOUNDSOFF: audioAllSoundsOff(); break;
+	case MIDI_PARAM_RESETCTRLS: audioResetCtrls(); break;
+	case MIDI_PARAM_ALLNOTESOFF: audioAllNotesOff(); break;
+	default: break;
+	}
+}
+
+void refSysExByte(uint8_t b)
+{
+// Header: 7D 5A <command> [<pattern>]
+	uint32_t pos = refSysExPos++;
+	if (pos == 0) {
+		refSysExOurs = b == ZEKIT_SYSEX_ID;
+		refSysExSum = 0;
+		refSysExCount = 0;
+		return;
+	}
+	if (!refSysExOurs) return;
+	if (pos == 1) {
+		refSysExOurs = b == ZEKIT_SYSEX_DEVICE;
+		return;
+	}
+	if (pos == 2) {
+		refSysExCommand = b;
+		return;
+	}
+	bool pattern = refSysExCommand == ZEKIT_SYSEX_PATTERN;
+	if (pattern && pos == 3) {
+		refSysExSum = b;
+		mseqImportBegin(b);
+		return;
+	}
+
+// Payload nibbles, high first, then the checksum
+	uint32_t nibble = pos - (pattern ? 4 : 3);
+	if (!(nibble & 1)) {
+		refSysExHigh = b;
+		return;
+	}
+	uint8_t data = ((refSysExHigh & 0x0F) << 4) | (b & 0x0F);
+	refSysExSum += data;
+	if (pattern) mseqImportByte(data);
+	else if (refSysExCount < sizeof(refSysExBytes))
+		refSysExBytes[refSysExCount] = data;
+	refSysExCount++;
+}
+
+void refSysExEnd(bool complete)
+{
+	if (!refSysExOurs || refSysExPos <= 3) return;
+	bool pattern = refSysExCommand == ZEKIT_SYSEX_PATTERN;
+	uint32_t nibbles = refSysExPos - (pattern ? 4 : 3);
+	bool valid = complete && (nibbles & 1) && refSysExHigh == (refSysExSum & 0x7F);
+
+	switch (refSysExCommand) {
+	case ZEKIT_SYSEX_PATTERN:
+		mseqImportEnd(valid);
+		break;
+	case ZEKIT_SYSEX_GLOBALS:
+		if (valid && refSysExCount == 3)
+			uiSetGlobals(refSysExBytes[0], refSysExBytes[1], refSysExBytes[2]);
+		break;
+	case ZEKIT_SYSEX_CC_MAP:
+		if (!valid) break;
+		if (refSysExCount == 0) refDefaultMap();
+		else if (refSysExCount == 2 && refSysExBytes[0] < 128 && refSysExBytes[1] < MIDI_PARAMS)
+			refMap[refSysExBytes[0]] = refSysExBytes[1];
+		break;
+	default: break;
+	}
+}
+
+/******************************************************************************/
+uint32_t rndNext()
+{
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 17;
+	rnd ^= rnd << 5;
+	return rnd;
+}
+
+int fuzzTraffic(uint8_t * data, int len)
+{
+	static const uint8_t realtimes[] = {0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF};
+	int count = 0;
+	while (count < len) {
+		uint32_t r = rndNext();
+		switch (r & 31) {
+		case 0:
+		// Sysex frame
+			count += fuzzSysEx(&data[count], len - count);
+			break;
+		case 1:
+		// System common, stray sysex begin or end
+			data[count++] = 0xF0 | ((r >> 5) & 7);
+			break;
+		case 2: case 3: case 4:
+		// Status on channel 0 or 1
+			data[count++] = 0x80 | ((r >> 5) & 0x70) | ((r >> 9) & 1);
+			break;
+		case 5: case 6:
+			data[count++] = realtimes[(r >> 5) & 7];
+			break;
+		case 7:
+		// Controller numbers in use
+			data[count++] = (r >> 5) & 1 ? 0x40 | ((r >> 6) & 0x1F) : (r >> 6) & 0x7F;
+			break;
+		default:
+			data[count++] = (r >> 5) & 0x7F;
+			break;
+		}
+	}
+	return len;
+}
+
+int fuzzSysEx(uint8_t * data, int len)
+{
+	static uint8_t frame[512];
+	uint32_t r = rndNext();
+	int count = 0;
+	frame[count++] = MIDI_SYSEX_BEGIN;
+
+// Header, sometimes foreign
+	uint8_t command = 1 + (r & 3);
+	frame[count++] = (r >> 2) & 7 ? ZEKIT_SYSEX_ID : 0x43;
+	frame[count++] = (r >> 5) & 7 ? ZEKIT_SYSEX_DEVICE : 0x10;
+	frame[count++] = command;
+
+// Payload: pattern, globals or a CC map entry
+	uint8_t sum = 0;
+	int bytes = 0;
+	switch (command) {
+	case ZEKIT_SYSEX_PATTERN:
+		sum = (r >> 8) & 0x3F;
+		frame[count++] = sum;
+		bytes = 6 + ((r >> 14) & 127);
+		break;
+	case ZEKIT_SYSEX_GLOBALS:
+		bytes = 3;
+		break;
+	case ZEKIT_SYSEX_CC_MAP:
+		bytes = (r >> 8) & 1 ? 2 : 0;
+		break;
+	default:
+		bytes = (r >> 8) & 15;
+		break;
+	}
+	if (!((r >> 21) & 7)) bytes += (r >> 24) & 3;
+	for (int i = 0; i < bytes; i++) {
+		uint32_t v = rndNext();
+		uint8_t data = v & 0xFF;
+		if (command == ZEKIT_SYSEX_CC_MAP)
+			data = i ? (v & 0xFF) % (MIDI_PARAMS + 2) : v & 0x7F;
+		sum += data;
+		frame[count++] = data >> 4;
+		frame[count++] = data & 0x0F;
+	}
+
+// Checksum, sometimes wrong, then the end byte or a status
+	frame[count++] = (r >> 26) & 7 ? sum & 0x7F : (sum + 1) & 0x7F;
+	uint32_t v = rndNext();
+	if (v & 7) frame[count++] = MIDI_SYSEX_END;
+	else if (v & 8) frame[count++] = 0x90 | ((v >> 4) & 1);
+	else count -= (v >> 4) & 3;
+
+// Realtime bytes inside the frame
+	int n = 0;
+	for (int i = 0; i < count && n < len; i++) {
+		if (!(rndNext() & 15)) {
+			data[n++] = MIDI_TICK;
+			if (n >= len) break;
+		}
+		data[n++] = frame[i];
+	}
+	return n;
+}
+
+int denseTraffic(uint8_t * data, int len)
+{
+	int count = 0;
+	int tick = 0;
+	while (count + 8 <= len) {
+	// Clock every 8 bytes: 24 PPQN at ~390 BPM on a full stream
+		data[count++] = MIDI_TICK;
+		uint32_t r = rndNext();
+		uint8_t channel = (r >> 16) & 1;
+		switch (tick++ & 3) {
+		case 0:
+			data[count++] = MIDI_NOTE_ON | channel;
+			data[count++] = 36 + (r & 31);
+			data[count++] = 100;
+			data[count++] = 36 + ((r >> 5) & 31);
+			data[count++] = 0;
+			break;
+		case 1:
+			data[count++] = MIDI_CC | channel;
+			data[count++] = MIDI_CC_CUTOFF;
+			data[count++] = r & 0x7F;
+			data[count++] = MIDI_CC_MODWHEEL;
+			data[count++] = (r >> 7) & 0x7F;
+			break;
+		case 2:
+			data[count++] = MIDI_PITCHBEND | channel;
+			data[count++] = r & 0x7F;
+			data[count++] = (r >> 7) & 0x7F;
+			data[count++] = (r >> 14) & 0x7F;
+			data[count++] = 0x40;
+			break;
+		default:
+			data[count++] = MIDI_NOTE_ON | channel;
+			data[count++] = 60 + (r & 7);
+			data[count++] = 90;
+			data[count++] = MIDI_NOTE_OFF | channel;
+			data[count++] = 60 + ((r >> 3) & 7);
+			break;
+		}
+	}
+	return count;
+}
+
+bool fuzzSeed(uint32_t seed, int len)
+{
+	static uint8_t data[1 << 20];
+	static Call newCalls[LOG_MAX];
+	if (len > (int) sizeof(data)) len = sizeof(data);
+	rnd = seed * 2654435761u | 1;
+	fuzzTraffic(data, len);
+
+// Table parser
+	midiInit();
+	midiChannel = seed & 1;
+	uiSystem = 0;
+	callsCount = 0;
+	for (int i = 0; i < len; i++) midiParse(data[i]);
+	int newCount = callsCount;
+	uint16_t newSystem = uiSystem;
+	memcpy(newCalls, calls, newCount * sizeof(Call));
+
+// Reference parser
+	refInit();
+	uiSystem = 0;
+	callsCount = 0;
+	for (int i = 0; i < len; i++) refParse(data[i]);
+
+// Compare the calls
+	int n = newCount < callsCount ? newCount : callsCount;
+	for (int i = 0; i < n; i++) {
+		const Call * a = &newCalls[i];
+		const Call * b = &calls[i];
+		if (a->name == b->name && a->a == b->a && a->b == b->b) continue;
+		printf("seed %u: call %d: %s(%d, %d) instead of %s(%d, %d)\n",
+			seed, i, a->name, a->a, a->b, b->name, b->a, b->b);
+		return false;
+	}
+	if (newCount != callsCount) {
+		printf("seed %u: %d calls instead of %d\n", seed, newCount, callsCount);
+		return false;
+	}
+
+// Compare the final state
+	if (memcmp(midiCCMap, refMap, sizeof(refMap))) {
+		printf("seed %u: CC maps differ\n", seed);
+		return false;
+	}
+	if (newSystem != uiSystem) {
+		printf("seed %u: system %u instead of %u\n", seed, newSystem, uiSystem);
+		return false;
+	}
+	return true;
+}
+
+double benchParser(void (*parse)(uint8_t), const uint8_t * data, int len)
+{
+// Fastest of several runs, the host is noisy
+	double best = 0;
+	for (int t = 0; t < 10; t++) {
+		struct timespec t0, t1;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (int i = 0; i < len; i++) parse(data[i]);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+		if (!t || ns < best) best = ns;
+	}
+	return best / len;
+}
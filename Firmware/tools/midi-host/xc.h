@@ -0,0 +1,32 @@
+/**
+ * ZeKit Firmware v2.0
+ * Copyright (C) 2021/2022 - Frdric Meslin
+ * Contact: fred@fredslab.net
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.	 If not, see <https://www.gnu.org/licenses/>.
+ */
+/******************************************************************************/
+
+#ifndef XC_H
+#define XC_H
+
+/*
+ * Host stand-in for the compiler device header: only the
+ * registers used by midi.c (the RX DMA count).
+ */
+	#include <stdint.h>
+
+	extern volatile uint16_t DMACNT1;
+
+#endif
@@ -0,0 +1,181 @@
+/**
+ * ZeKit Firmware v2.0
+ * Copyright (C) 2021/2022 - Frdric Meslin
+ * Contact: fred@fredslab.net
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.	 If not, see <https://www.gnu.org/licenses/>.
+ */
+/******************************************************************************/
+
+/*
+ * Host test of the pattern records (mseq.c), built over a
+ * RAM flash with stubbed audio functions:
+ *	cc -O2 -I. -I../.. -o mseq-host mseq-host.c
+ *	./mseq-host
+ * A pattern is saved in its page after filler records leaving
+ * every possible free space, with and without timing and gates.
+ * It must reload as saved, and the next pattern page must not
+ * change (a record not fitting erases the page first).
+ * Exits with 1 when a case fails.
+ */
+
+#include "../../mseq.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************/
+// RAM flash
+#define FLASH_SIZE		STORE_PATTERNS_ADDR(SEQ_PATTERNS_MAX)
+
+static uint8_t flash[FLASH_SIZE];
+
+static void flashFill(uint32_t addr, uint8_t id, uint16_t bytes);
+
+/******************************************************************************/
+// Test patterns
+#define TEST_ID			10
+#define TEST_STEPS		40
+
+enum {
+	TEST_PLAIN = 0,
+	TEST_TIMING,
+	TEST_GATES,
+	TEST_BOTH,
+	TEST_KINDS
+};
+
+static Pattern * testBuild(uint8_t id, int kind);
+static bool testSame(const Pattern * p, const Pattern * h, const uint8_t * block);
+static bool testCase(int kind, uint16_t free);
+
+/******************************************************************************/
+// Firmware stubs
+uint16_t uwTick;
+
+uint32_t timeNow() {return (uint32_t) uwTick * 250;}
+
+void storeErasePage(uint32_t addr) {memset(&flash[addr & ~(FLASH_PAGE_SIZE - 1)], 0xFF, FLASH_PAGE_SIZE);}
+void storeRead32(uint32_t addr, uint32_t * dword) {memcpy(dword, &flash[addr], 4);}
+void storeWrite32(uint32_t addr, const uint32_t * dword) {memcpy(&flash[addr], dword, 4);}
+bool storePending() {return false;}
+
+void audioNoteOn(uint8_t note) {}
+void audioNotesOn(const uint8_t * notes, int count) {}
+void audioNoteOff(uint8_t note) {}
+void audioAllNotesOff() {}
+int audioGetNoVoices() {return 0;}
+
+/******************************************************************************/
+int main(int argc, char ** argv)
+{
+	static const char * names[TEST_KINDS] = {"plain", "timing", "gates", "timing and gates"};
+	int failed = 0;
+	for (int kind = 0; kind < TEST_KINDS; kind++) {
+		int cases = 0;
+		int bad = 0;
+		for (uint16_t free = 0; free <= FLASH_PAGE_SIZE - 8; free += 4) {
+			if (free == FLASH_PAGE_SIZE - 4) continue;
+			if (!testCase(kind, free)) bad++;
+			cases++;
+		}
+		printf("records (%s): %d / %d free spaces ok\n", names[kind], cases - bad, cases);
+		failed += bad;
+	}
+	return failed ? 1 : 0;
+}
+
+/******************************************************************************/
+void flashFill(uint32_t addr, uint8_t id, uint16_t bytes)
+{
+// Records of one step, up to the full data size
+	while (bytes) {
+		uint16_t record = bytes;
+		if (record > 8 + PATTERN_DATA_MAX) record = 8 + PATTERN_DATA_MAX;
+		if (bytes - record > 0 && bytes - record < 8) record -= 8;
+		uint32_t header = 60 | 1 << 8 | (uint32_t) id << 16 | (uint32_t) PATTERN_COMPACT << 24;
+		uint32_t size = record - 8;
+		storeWrite32(addr, &header);
+		storeWrite32(addr + 4, &size);
+		memset(&flash[addr + 8], 0, size);
+		addr += record;
+		bytes -= record;
+	}
+}
+
+/******************************************************************************/
+Pattern * testBuild(uint8_t id, int kind)
+{
+	Pattern * p = seqPatternFetch(id);
+	patternClear(p);
+	for (int s = 0; s < TEST_STEPS; s++) {
+		uint8_t notes[SEQ_NOTES_MAX];
+		for (int n = 0; n < SEQ_NOTES_MAX; n++)
+			notes[n] = n <= s % SEQ_NOTES_MAX ? 36 + s + n : STEP_EMPTY;
+		patternAppend(p, notes);
+	}
+	if (kind & TEST_TIMING) {
+		p->swing = 40;
+		for (int s = 0; s < TEST_STEPS; s++)
+			patternOffsets(p)[s] = s & 7;
+	}
+	if (kind & TEST_GATES) {
+		for (int s = 0; s < TEST_STEPS; s++)
+			patternGates(p)[s] = 32 + s;
+	}
+	return p;
+}
+
+bool testSame(const Pattern * p, const Pattern * h, const uint8_t * block)
+{
+// Header and block (offsets, gates, data)
+	if (p->root != h->root || p->length != h->length) return false;
+	if (p->size != h->size || p->swing != h->swing) return false;
+	return !memcmp(patternOffsets(p), block, 2 * h->length + h->size);
+}
+
+bool testCase(int kind, uint16_t free)
+{
+// Next page holds a saved pattern
+	memset(flash, 0xFF, sizeof(flash));
+	mseqInit();
+	Pattern * next = testBuild(TEST_ID + 1, TEST_BOTH);
+	seqPatternsSave(next);
+	static uint8_t page[FLASH_PAGE_SIZE];
+	memcpy(page, &flash[STORE_PATTERNS_ADDR(TEST_ID + 1)], FLASH_PAGE_SIZE);
+
+// Save in a page with the given free space
+	flashFill(STORE_PATTERNS_ADDR(TEST_ID), TEST_ID, FLASH_PAGE_SIZE - free);
+	Pattern * p = testBuild(TEST_ID, kind);
+	seqPatternsSave(p);
+	Pattern saved = *p;
+	uint8_t block[PATTERN_BLOCK_MAX];
+	memcpy(block, patternOffsets(p), 2 * p->length + p->size);
+
+// Reload from flash
+	seqPatternEvict(p);
+	p = seqPatternFetch(TEST_ID);
+
+	bool ok = true;
+	if (!testSame(p, &saved, block)) {
+		printf("free %u: pattern reloaded with length %u, size %u\n", free, p->length, p->size);
+		ok = false;
+	}
+	if (memcmp(page, &flash[STORE_PATTERNS_ADDR(TEST_ID + 1)], FLASH_PAGE_SIZE)) {
+		printf("free %u: next pattern page overwritten\n", free);
+		ok = false;
+	}
+	return ok;
+}
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+"""
+ZeKit Firmware v2.0 - Sysex transfer tool
+Copyright (C) 2021/2022 - Frederic Meslin
+Licensed under GPLv3 terms (see license.txt)
+
+Builds the sysex messages loading patterns and globals into a
+ZeKit, from JSON descriptions, and decodes them back. The .syx
+files can be sent with any sysex utility (amidi -s, SysEx
+Librarian, MIDI-OX...) or directly with --port (needs mido).
+
+Each pattern is written to flash after it is received: leave
+100ms between the messages of a bank (send --delay does it,
+set the delay between buffers of other utilities). Without
+the pause, a pattern holds the MIDI input until the previous
+one is written and incoming bytes may be lost.
+
+Pattern description (JSON), one object or a list (bank):
+    {"pattern": 3, "root": 48, "swing": 0,
+     "steps": [[60, 64], [], ["tie", 67]],
+     "offsets": [0, 0, 0], "gates": [128, 128, 128]}
+Steps hold up to 4 note slots (MIDI note, "tie" or null),
+95 steps at most.
+Offsets delay the steps (1/256 step), gates are in 1/256 step.
+
+Globals description (JSON):
+    {"globals": {"channel": 0, "clocking": 3, "tuning": 32}}
+
+CC map description (JSON), "default" restores the factory map:
+    {"ccmap": {"20": "glide", "21": "tempo"}}
+    {"ccmap": "default"}
+"""
+
+import argparse
+import json
+import sys
+
+SYSEX_ID = 0x7D
+SYSEX_DEVICE = 0x5A
+SYSEX_PATTERN = 0x01
+SYSEX_GLOBALS = 0x02
+SYSEX_CC_MAP = 0x03
+
+PARAMS = ["none", "wheel", "wave", "pattern", "cutoff", "chain", "chain-edit",
+          "swing", "step-offset", "step-gate", "arp", "arp-octaves", "note-priority",
+          "glide", "vibrato-rate", "vibrato-depth", "system", "clock-div", "tempo",
+          "all-sounds-off", "reset-ctrls", "all-notes-off"]
+
+STEPS_MAX = 95
+NOTES_MAX = 4
+HALF_RES = 128
+SLOT_NOTE = 1
+SLOT_TIE = 2
+
+
+def encode_steps(steps):
+    data = bytearray()
+    for step in steps:
+        mask, notes = 0, []
+        for n, slot in enumerate(step[:NOTES_MAX]):
+            if slot == "tie":
+                mask |= SLOT_TIE << (n * 2)
+            elif slot is not None:
+                mask |= SLOT_NOTE << (n * 2)
+                notes.append(int(slot) & 0x7F)
+        data.append(mask)
+        data.extend(notes)
+    return data
+
+
+def decode_steps(data, length):
+    steps, pos = [], 0
+    for _ in range(length):
+        mask = data[pos]
+        pos += 1
+        step = []
+        for n in range(NOTES_MAX):
+            code = (mask >> (n * 2)) & 3
+            if code == SLOT_NOTE:
+                step.append(data[pos])
+                pos += 1
+            elif code == SLOT_TIE:
+                step.append("tie")
+            else:
+                step.append(None)
+        while step and step[-1] is None:
+            step.pop()
+        steps.append(step)
+    return steps
+
+
+def message(command, payload, prefix=b""):
+    body = bytearray(prefix)
+    for b in payload:
+        body += bytes([b >> 4, b & 0x0F])
+    checksum = (sum(prefix) + sum(payload)) & 0x7F
+    return bytes([0xF0, SYSEX_ID, SYSEX_DEVICE, command]) + body + bytes([checksum, 0xF7])
+
+
+def pattern_message(p):
+    steps = p.get("steps", [])
+    length = len(steps)
+    if length > STEPS_MAX:
+        raise ValueError("pattern %d: too many steps" % p["pattern"])
+    data = encode_steps(steps)
+    offsets = p.get("offsets", [0] * length)
+    gates = p.get("gates", [HALF_RES] * length)
+    if len(offsets) != length or len(gates) != length:
+        raise ValueError("pattern %d: offsets / gates length" % p["pattern"])
+    payload = bytearray([p.get("root", 48), length, p.get("flags", 0), p.get("swing", 0)])
+    payload += bytes([len(data) & 0xFF, len(data) >> 8])
+    payload += data + bytes(offsets) + bytes(gates)
+    return message(SYSEX_PATTERN, payload, bytes([p["pattern"]]))
+
+
+def globals_message(g):
+    payload = bytes([g.get("channel", 0), g.get("clocking", 3), g.get("tuning", 32)])
+    return message(SYSEX_GLOBALS, payload)
+
+
+def ccmap_messages(m):
+    if m == "default":
+        return message(SYSEX_CC_MAP, b"")
+    out = bytearray()
+    for cc, param in m.items():
+        out += message(SYSEX_CC_MAP, bytes([int(cc), PARAMS.index(param)]))
+    return bytes(out)
+
+
+def encode(doc):
+    items = doc if isinstance(doc, list) else [doc]
+    out = bytearray()
+    for item in items:
+        if "globals" in item:
+            out += globals_message(item["globals"])
+        elif "ccmap" in item:
+            out += ccmap_messages(item["ccmap"])
+        else:
+            out += pattern_message(item)
+    return bytes(out)
+
+
+def split(syx):
+    msgs, start = [], None
+    for i, b in enumerate(syx):
+        if b == 0xF0:
+            start = i
+        elif b == 0xF7 and start is not None:
+            msgs.append(syx[start:i + 1])
+            start = None
+    return msgs
+
+
+def decode(syx):
+    items = []
+    for m in split(syx):
+        if len(m) < 6 or m[1] != SYSEX_ID or m[2] != SYSEX_DEVICE:
+            continue
+        command, body, checksum = m[3], m[4:-2], m[-2]
+        prefix = body[:1] if command == SYSEX_PATTERN else b""
+        nibbles = body[len(prefix):]
+        payload = bytes((nibbles[i] << 4) | nibbles[i + 1] for i in range(0, len(nibbles) - 1, 2))
+        if (sum(prefix) + sum(payload)) & 0x7F != checksum:
+            raise ValueError("bad checksum")
+        if command == SYSEX_CC_MAP:
+            items.append({"ccmap": {str(payload[0]): PARAMS[payload[1]]} if payload else "default"})
+        elif command == SYSEX_GLOBALS:
+            items.append({"globals": {"channel": payload[0], "clocking": payload[1], "tuning": payload[2]}})
+        elif command == SYSEX_PATTERN:
+            length, size = payload[1], payload[4] | (payload[5] << 8)
+            data = payload[6:6 + size]
+            items.append({
+                "pattern": prefix[0], "root": payload[0], "flags": payload[2], "swing": payload[3],
+                "steps": decode_steps(data, length),
+                "offsets": list(payload[6 + size:6 + size + length]),
+                "gates": list(payload[6 + size + length:6 + size + 2 * length])})
+    return items
+
+
+def send(syx, port, delay):
+    import mido
+    import time
+    with mido.open_output(port) as out:
+        for m in split(syx):
+            out.send(mido.Message("sysex", data=list(m[1:-1])))
+            time.sleep(delay)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="ZeKit sysex transfer tool")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    e = sub.add_parser("encode", help="JSON description to .syx")
+    e.add_argument("json")
+    e.add_argument("syx")
+    d = sub.add_parser("decode", help=".syx to JSON description")
+    d.add_argument("syx")
+    s = sub.add_parser("send", help="send a .syx file to a MIDI port")
+    s.add_argument("syx")
+    s.add_argument("--port", required=True)
+    s.add_argument("--delay", type=float, default=0.1, help="pause after each message (s)")
+    args = parser.parse_args()
+
+    if args.cmd == "encode":
+        with open(args.json) as f:
+            syx = encode(json.load(f))
+        with open(args.syx, "wb") as f:
+            f.write(syx)
+    elif args.cmd == "decode":
+        with open(args.syx, "rb") as f:
+            json.dump(decode(f.read()), sys.stdout, indent=1)
+            print()
+    elif args.cmd == "send":
+        with open(args.syx, "rb") as f:
+            send(f.read(), args.port, args.delay)
+
+
+if __name__ == "__main__":
+    main()
@@ -40,6 +40,7 @@ typedef enum {
 	PAGE_PATTERN_SELECT,
 	PAGE_MIDI_SELECT,
 	PAGE_CLOCKING_SELECT,
+	PAGE_RENDER_LOAD,
 } UI_MODE;
 UI_MODE uiPage;
 
@@ -48,14 +49,19 @@ uint16_t uiSwitches;
 uint16_t uiSwitchesLast;
 uint16_t uiBlinkStamp;
 
-uint16_t uiSwitchPortA;
-uint16_t uiSwitchPortB;
+static uint16_t uiScanStamp;
+static uint16_t uiScanRaw;
+static uint16_t uiScanStable;
+static uint16_t uiDisplayStamp;
+static uint16_t uiLedsA;
+static uint16_t uiLedsB;
 
 static void uiScan();
 static void uiEvents();
 static void uiDisplay();
 static void uiLoadGlobals();
 static void uiSaveGlobals();
+static void uiApplyGlobals(uint32_t channel, uint32_t clocking, uint32_t tuning);
 
 static int uiPageFromSwitch(int pressed);
 
@@ -72,8 +78,12 @@ void uiInit()
 	uiSwitchesLast = 0xFFFF;
 	uiBlinkStamp = uwTick;
 
-	uiSwitchPortA = 0xFFFF;
-	uiSwitchPortB = 0xFFFF;
+	uiScanStamp = uwTick;
+	uiScanRaw = 0xFFFF;
+	uiScanStable = 0;
+	uiDisplayStamp = uwTick - 1;
+	uiLedsA = 0;
+	uiLedsB = 0;
 
 	uiLoadGlobals();
 }
@@ -81,8 +91,12 @@ void uiInit()
 void uiUpdate()
 {
 	uiScan();
-	uiEvents();
-	uiDisplay();
+	if (uiSwitches != uiSwitchesLast) {
+		uiEvents();
+		uiDisplay();
+	}else if (uwTick != uiDisplayStamp) {
+		uiDisplay();
+	}
 }
 
 /******************************************************************************/
@@ -90,23 +104,44 @@ inline void uiScan()
 {
 // Cache the switch states
 	uiSwitchesLast = uiSwitches;
-	uiSwitches = 0;
-	
-// Translate the states	
-	if (uiSwitchPortA & PORTA_TACT_PATTERN) 
-		uiSwitches |= TACT_PATTERN;
-	if (uiSwitchPortA & PORTA_TACT_SYSTEM) 
-		uiSwitches |= TACT_SYSTEM;
-	if (uiSwitchPortA & PORTA_TACT_WAVE) 
-		uiSwitches |= TACT_WAVE;
-	if (uiSwitchPortB & PORTB_TACT_PLAY) 
-		uiSwitches |= TACT_PLAY;
-	if (uiSwitchPortB & PORTB_TACT_REC) 
-		uiSwitches |= TACT_REC;
-	if (uiSwitchPortB & PORTB_TACT_TAP) 
-		uiSwitches |= TACT_TAP;
-	if (uiSwitchPortB & PORTB_TACT_SAVE) 
-		uiSwitches |= TACT_SAVE;
+	if (uwTick == uiScanStamp) return;
+	uiScanStamp = uwTick;
+
+// Read the switches (LEDs off)
+	__asm volatile ("disi #20\n");
+	TRISA |= PORTA_TACTS;
+	TRISB |= PORTB_TACTS;
+	__asm volatile ("repeat #10\n nop\n");
+	uint16_t portA = PORTA;
+	uint16_t portB = PORTB;
+	TRISA &= ~PORTA_TACTS;
+	TRISB &= ~PORTB_TACTS;
+
+// Translate the states
+	uint16_t raw = 0;
+	if (portA & PORTA_TACT_PATTERN) 
+		raw |= TACT_PATTERN;
+	if (portA & PORTA_TACT_SYSTEM) 
+		raw |= TACT_SYSTEM;
+	if (portA & PORTA_TACT_WAVE) 
+		raw |= TACT_WAVE;
+	if (portB & PORTB_TACT_PLAY) 
+		raw |= TACT_PLAY;
+	if (portB & PORTB_TACT_REC) 
+		raw |= TACT_REC;
+	if (portB & PORTB_TACT_TAP) 
+		raw |= TACT_TAP;
+	if (portB & PORTB_TACT_SAVE) 
+		raw |= TACT_SAVE;
+
+// Debounce (stable for a few ticks)
+	if (raw != uiScanRaw) {
+		uiScanRaw = raw;
+		uiScanStable = 0;
+	}else if (uiScanStable < UI_DEBOUNCE) {
+		if (++uiScanStable == UI_DEBOUNCE)
+			uiSwitches = raw;
+	}
 }
 
 /******************************************************************************/
@@ -149,6 +184,10 @@ inline void uiEvents()
 			mseqSetClocking(value ^ code);
 			break;
 
+		case PAGE_RENDER_LOAD:
+			audioResetLoad();
+			break;
+
 		default: break;
 		}
 	}
@@ -164,6 +203,8 @@ inline void uiEvents()
 		audioSetWheel(0);	// Stop the vibrato
 	if (newPage == uiPage) newPage = PAGE_HOME;
 	else uiBlinkStamp = uwTick;
+	if (newPage == PAGE_RENDER_LOAD)
+		audioResetLoad();
 
 	int lastPage = uiPage;
 	uiPage = newPage;
@@ -185,11 +226,13 @@ int uiPageFromSwitch(int pressed)
 	
 	if (pressed & TACT_SYSTEM) {
 		if (!(uiSwitches & TACT_WAVE)) return PAGE_CLOCKING_SELECT;
+		if (!(uiSwitches & TACT_PATTERN)) return PAGE_RENDER_LOAD;
 		return PAGE_SYSTEM_SELECT;
 	}
 	
 	if (pressed & TACT_PATTERN) {
 		if (!(uiSwitches & TACT_WAVE)) return PAGE_MIDI_SELECT;
+		if (!(uiSwitches & TACT_SYSTEM)) return PAGE_RENDER_LOAD;
 		return PAGE_PATTERN_SELECT;
 	}
 	
@@ -200,69 +243,98 @@ int uiPageFromSwitch(int pressed)
 inline void uiDisplay()
 {
 	int display = 0;
+	uint16_t ledsA = 0;
+	uiDisplayStamp = uwTick;
 	uint16_t dt = uwTick - uiBlinkStamp;
 	bool blink = dt < 250;
 	if (dt >= 500) uiBlinkStamp = uwTick;
 
 // Display engine state
-	LED_MODES_Blank();
 	switch (uiPage) {
 	case PAGE_WAVEFORM_SELECT:
-		if (blink) LED_WAVE_SetHigh();
+		if (blink) ledsA = PORTA_TACT_WAVE;
 		display = audioGetWave();
 		break;
 
 	case PAGE_SYSTEM_SELECT:
-		if (blink) LED_SYSTEM_SetHigh();
+		if (blink) ledsA = PORTA_TACT_SYSTEM;
 		display = uiSystem;
 		break;
 
 	case PAGE_PATTERN_SELECT:
-		if (blink) LED_PATTERN_SetHigh();
+		if (blink) ledsA = PORTA_TACT_PATTERN;
 		display = mseqGetPattern();
 		break;
 
 	case PAGE_MIDI_SELECT:
-		if (blink) {
-			LED_WAVE_SetHigh();
-			LED_PATTERN_SetHigh();
-		}
+		if (blink) ledsA = PORTA_TACT_WAVE | PORTA_TACT_PATTERN;
 		display = midiGetChannel();
 		break;
 
 	case PAGE_CLOCKING_SELECT:
-		if (blink) {
-			LED_WAVE_SetHigh();
-			LED_SYSTEM_SetHigh();
-		}
+		if (blink) ledsA = PORTA_TACT_WAVE | PORTA_TACT_SYSTEM;
 		display = mseqGetClocking();
 		break;
+
+	case PAGE_RENDER_LOAD: {
+	// Worst render end (quarter blocks), blinks on late blocks
+		if (blink) ledsA = PORTA_TACT_SYSTEM | PORTA_TACT_PATTERN;
+		uint16_t quarters = (audioLoad.exitMax * 4 + AUDIO_BUFFER_LEN - 1) / AUDIO_BUFFER_LEN;
+		display = (1 << (quarters > 4 ? 4 : quarters)) - 1;
+		if ((audioLoad.late || audioLoad.overruns) && !blink) display = 0;
+	} break;
 		
 	default: {
 		MSEQ_STATES state = mseqGetState();
-		if (seqPlayBlink ^ (state == MSEQ_STATE_PLAY)) display |= 0x01;
-		if (seqRecBlink ^ (state == MSEQ_STATE_RECORD)) display |= 0x02;
+		bool play = state == MSEQ_STATE_PLAY || state == MSEQ_STATE_OVERDUB;
+		bool rec = state == MSEQ_STATE_RECORD || state == MSEQ_STATE_OVERDUB;
+		if (seqPlayBlink ^ play) display |= 0x01;
+		if (seqRecBlink ^ rec) display |= 0x02;
 		if (seqTapBlink) display |= 0x04;
 		if (seqSaveBlink) display |= 0x08;
 	} break;
 	}
 
 // Display current selection
-	LED_SEQ_Blank();
-	if (display & 0x08) LED_SAVE_SetHigh();
-	if (display & 0x04) LED_TAP_SetHigh();
-	if (display & 0x02) LED_REC_SetHigh();
-	if (display & 0x01) LED_PLAY_SetHigh();
+	uint16_t ledsB = 0;
+	if (display & 0x08) ledsB |= PORTB_TACT_SAVE;
+	if (display & 0x04) ledsB |= PORTB_TACT_TAP;
+	if (display & 0x02) ledsB |= PORTB_TACT_REC;
+	if (display & 0x01) ledsB |= PORTB_TACT_PLAY;
+
+// Write the ports on change only (LEDs active low)
+	if (ledsA != uiLedsA) {
+		LATA |= PORTA_TACTS & ~ledsA;
+		LATA &= ~ledsA;
+		uiLedsA = ledsA;
+	}
+	if (ledsB != uiLedsB) {
+		LATB |= PORTB_TACTS & ~ledsB;
+		LATB &= ~ledsB;
+		uiLedsB = ledsB;
+	}
 }
 
 /******************************************************************************/
 void uiLoadGlobals()
 {
-// Load and sanitize globals
+// Load globals
 	uint32_t channel, clocking, tuning;
 	storeRead32(GLOBAL_MIDICHANNEL_ADDR, &channel);
 	storeRead32(GLOBAL_CLOCKING_ADDR, &clocking);
 	storeRead32(GLOBAL_FRCTUNING_ADDR, &tuning);
+	uiApplyGlobals(channel, clocking, tuning);
+}
+
+void uiSetGlobals(int channel, int clocking, int tuning)
+{
+	uiApplyGlobals(channel, clocking, tuning);
+	uiSaveGlobals();
+}
+
+void uiApplyGlobals(uint32_t channel, uint32_t clocking, uint32_t tuning)
+{
+// Sanitize globals
 	if (channel > 15) channel = 0;
 	if (clocking > 15) clocking = 3;
 	if (tuning > 63) tuning = 32;
@@ -23,6 +23,8 @@
 
 	#include <stdint.h>
 
+	#define UI_DEBOUNCE		2		// switches stable scans (10ms)
+
 	typedef enum{
 		TACT_PATTERN	= 0x01,
 		TACT_SYSTEM		= 0x02,
@@ -44,13 +46,11 @@
 	extern uint16_t uiSwitches;
 	extern uint16_t uiSwitchesLast;
 
-	extern uint16_t uiSwitchPortA;
-	extern uint16_t uiSwitchPortB;
-
 /******************************************************************************/
 	void uiInit();
 	void uiUpdate();
 
 	void uiFRCTuning(int value);
+	void uiSetGlobals(int channel, int clocking, int tuning);
 
 #endif